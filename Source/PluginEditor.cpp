@@ -24,11 +24,9 @@ void LookAndFeel::drawRotarySlider(juce::Graphics& g,
 
     auto bounds = Rectangle<float>(x, y, width, width);
 
-    g.setColour(Colours::white);
-    g.fillEllipse(bounds);
-
-    g.setColour(Colours::darkgrey);
-    g.drawEllipse(bounds, 1.f);
+    // The face has a pixel of margin for the outline
+    auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+    g.drawImage(getKnobFace(width, scale), bounds.expanded(1.f));
 
     if (auto* rswl = dynamic_cast<RotarySliderWithLabels*>(&slider))
     {
@@ -76,6 +74,58 @@ void LookAndFeel::drawRotarySlider(juce::Graphics& g,
 
 
 
+const juce::Image& LookAndFeel::getKnobFace(int diameter, float scale)
+{
+    using namespace juce;
+
+    for (const auto& face : knobFaces)
+        if (face.diameter == diameter && face.scale == scale)
+            return face.image;
+
+    auto size = jmax(1, roundToInt(float(diameter + 2) * scale));
+    Image image(Image::ARGB, size, size, true);
+
+    {
+        Graphics g(image);
+        g.addTransform(AffineTransform::scale(scale));
+
+        auto bounds = Rectangle<float>(1.f, 1.f, (float)diameter, (float)diameter);
+
+        g.setColour(Colours::white);
+        g.fillEllipse(bounds);
+
+        g.setColour(Colours::darkgrey);
+        g.drawEllipse(bounds, 1.f);
+    }
+
+    knobFaces.push_back({ diameter, scale, image });
+    return knobFaces.back().image;
+}
+
+
+
+const juce::Path& LookAndFeel::getAnalyzerGlyph()
+{
+    static const auto glyph = []
+        {
+            // A fixed seed, so it's the same squiggle in every editor and on every repaint
+            juce::Random random(0x5151);
+            juce::Path path;
+
+            constexpr int numPoints = 24;
+            path.startNewSubPath(0.f, random.nextFloat());
+
+            for (int i = 1; i < numPoints; ++i)
+                path.lineTo((float)i / float(numPoints - 1), random.nextFloat());
+
+            return path;
+        }();
+
+    return glyph;
+}
+
+
+
 void LookAndFeel::drawToggleButton(juce::Graphics& g,
                                    juce::ToggleButton& toggleButton,
                                    bool shouldDrawButtonAsHighlighted,
@@ -86,33 +136,37 @@ void LookAndFeel::drawToggleButton(juce::Graphics& g,
     // if the passed button is a powerbutton
     if (auto pb = dynamic_cast<PowerButton*>(&toggleButton))
     {
-        Path powerButton;
-        
         auto bounds = toggleButton.getLocalBounds();
         auto size = jmin(bounds.getWidth(), bounds.getHeight()) - 6;
         
         auto r = bounds.withSizeKeepingCentre(size, size).toFloat();
         
-        float angle = 30.f * MathConstants<float>::pi / 180.f;
-        
-        size -= 6;
-        
-        powerButton.addCentredArc(r.getCentreX(),
-                                  r.getCentreY(),
-                                  size * 0.5f,
-                                  size * 0.5f,
-                                  0.f,
-                                  angle,
-                                  angle - MathConstants<float>::pi * 2.f,
-                                  true);
-        
-        powerButton.startNewSubPath(r.getCentreX(), r.getY());
-        powerButton.lineTo(r.getCentre());
+        if (bounds != powerGlyphBounds)
+        {
+            powerGlyphBounds = bounds;
+            powerGlyph.clear();
+
+            float angle = 30.f * MathConstants<float>::pi / 180.f;
+
+            size -= 6;
+
+            powerGlyph.addCentredArc(r.getCentreX(),
+                                     r.getCentreY(),
+                                     size * 0.5f,
+                                     size * 0.5f,
+                                     0.f,
+                                     angle,
+                                     angle - MathConstants<float>::pi * 2.f,
+                                     true);
+
+            powerGlyph.startNewSubPath(r.getCentreX(), r.getY());
+            powerGlyph.lineTo(r.getCentre());
+        }
         
         PathStrokeType pst(2.f, PathStrokeType::JointStyle::curved);
         auto color = toggleButton.getToggleState() ? Colour(0x66ff68a0) : Colour(0xffff68a0);
         g.setColour(color);
-        g.strokePath(powerButton, pst);
+        g.strokePath(powerGlyph, pst);
         
         g.drawEllipse(r.toFloat(), 2.f);
     }
@@ -123,20 +177,12 @@ void LookAndFeel::drawToggleButton(juce::Graphics& g,
         g.setColour(color);
 
         auto bounds = toggleButton.getLocalBounds();
-        auto insetRect = bounds.reduced(4.f);
-
-        Path randomPath;
-
-        Random r;
-        randomPath.startNewSubPath(insetRect.getX(),
-								   insetRect.getY() + insetRect.getHeight() * r.nextFloat());
-
-        for (auto x = insetRect.getX() + 1; x < insetRect.getRight(); x += 2)
-        {
-            randomPath.lineTo(x,insetRect.getY() + insetRect.getHeight() * r.nextFloat());
-        }
+        auto insetRect = bounds.reduced(4.f).toFloat();
 
-        g.strokePath(randomPath, PathStrokeType(2.f));
+        // Scaled into place by the transform, which leaves the stroke width alone
+        g.strokePath(getAnalyzerGlyph(), PathStrokeType(2.f),
+                     AffineTransform::scale(insetRect.getWidth(), insetRect.getHeight())
+                         .translated(insetRect.getX(), insetRect.getY()));
     }
 
 }
@@ -172,6 +218,45 @@ void RotarySliderWithLabels::paint(juce::Graphics& g)
                                       *this);
 
 
+    auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+
+    if (scale != labelsLayerScale || !labelsLayer.isValid())
+    {
+        labelsLayerScale = scale;
+        labelsLayer = Image(Image::ARGB,
+                            jmax(1, roundToInt((float)getWidth() * scale)),
+                            jmax(1, roundToInt((float)getHeight() * scale)),
+                            true);
+
+        Graphics lg(labelsLayer);
+        lg.addTransform(AffineTransform::scale(scale));
+        drawLabels(lg);
+    }
+
+    g.drawImage(labelsLayer, getLocalBounds().toFloat());
+}
+
+
+
+void RotarySliderWithLabels::resized()
+{
+    juce::Slider::resized();
+
+    // Drawn again at the next paint
+    labelsLayer = {};
+}
+
+
+
+void RotarySliderWithLabels::drawLabels(juce::Graphics& g)
+{
+    using namespace juce;
+
+    auto startAngle = degreesToRadians(180.f + 45.f);
+    auto endAngle = degreesToRadians(180.f - 45.f) + MathConstants<float>::twoPi;
+
+    auto sliderBounds = getSliderBounds();
+
     auto center = sliderBounds.toFloat().getCentre();
     auto radius = sliderBounds.getWidth() * 0.5f;
 
@@ -267,30 +352,63 @@ juce::String RotarySliderWithLabels::getDisplayString() const
 
 ResponseCurveComponent::ResponseCurveComponent(SimpleQAudioProcessor& p) :
     audioProcessor(p),
-    //leftChannelFifo(&audioProcessor.leftChannelFifo)
-    leftPathProducer(audioProcessor.leftChannelFifo),
-    rightPathProducer(audioProcessor.rightChannelFifo)
+    analyzerFeed(audioProcessor.acquireAnalyzerFeed()),
+    pathProducer(analyzerFeed.leftChannel, analyzerFeed.rightChannel)
 {
-	const auto& params = audioProcessor.getParameters();
-    for (auto param : params)
+    // Only the filter parameters can change the curve, so only they arm the
+    // fallback in updateSnapshot(); the analyzer switch or the morph time don't
+    for (const auto& parameterID : getChainSettingsParameterIDs())
     {
-		param->addListener(this);
+		audioProcessor.apvts.getParameter(parameterID)->addListener(this);
 	}
 
-    updateChain();
+    updateSnapshot();
 
-	startTimerHz(60);
+    toggleAnalysisEnablement(audioProcessor.apvts.getRawParameterValue("Analyzer Enabled")->load() > 0.5f);
 }
 
 
 
 ResponseCurveComponent::~ResponseCurveComponent()
 {
-	const auto& params = audioProcessor.getParameters();
-    for (auto param : params)
+    for (const auto& parameterID : getChainSettingsParameterIDs())
     {
-		param->removeListener(this);
+		audioProcessor.apvts.getParameter(parameterID)->removeListener(this);
 	}
+
+    toggleAnalysisEnablement(false);
+
+    // Waits if a worker is in the middle of our analysis, which reads the feed
+    analysisWorkers->pool.removeJob(&analysisJob, false, -1);
+
+    audioProcessor.releaseAnalyzerFeed();
+}
+
+
+
+juce::String ResponseCurveComponent::getAnalyzerMemoryReport() const
+{
+    juce::String report;
+    report << "Analyzer: " << (juce::int64)pathProducer.getNumBytes() << " bytes" << juce::newLine;
+    return report;
+}
+
+
+
+void ResponseCurveComponent::toggleAnalysisEnablement(bool enabled)
+{
+    if (enabled == shouldShowFFTAnalysis)
+        return;
+
+    shouldShowFFTAnalysis = enabled;
+
+    if (enabled)
+        audioProcessor.subscribeToAnalyzer();
+    else
+        audioProcessor.unsubscribeFromAnalyzer();
+
+    // Clears the traces, the next frame won't come if nothing is being analysed
+    repaint(getRenderArea());
 }
 
 
@@ -301,165 +419,740 @@ void ResponseCurveComponent::parameterValueChanged(int parameterIndex, float new
 }
 
 
+void PathProducer::prepareAnalysis()
+{
+    for (auto& ring : lowBandRings)
+        ring.prepare(analyzerMaxWindowSize);
+
+    decimatedScratch.resize((size_t)(analyzerMaxWindowSize / lowBandDecimation + 1));
+
+    applyOrder(appliedRequestedOrder);
+    isAnalysisPrepared = true;
+}
+
+
 void PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate)
 {
-    juce::AudioBuffer<float> tempIncomingBuffer;
+    if (!isAnalysisPrepared)
+        prepareAnalysis();
+
+    // Settings changed on the message thread are picked up here, so the
+    // analysis state itself is only ever touched by the worker
+    auto order = requestedOrder.load();
+    if (order != appliedRequestedOrder || (!autoStepDown && currentOrder != order))
+    {
+        appliedRequestedOrder = order;
+        applyOrder(order);
+    }
+
+    auto currentView = view.load();
+    if (currentView != appliedView)
+    {
+        appliedView = currentView;
+        lastWindowEnd = -1;
+
+        for (auto& generator : pathGenerators)
+            generator.resetBallistics();
+    }
+
+    // Trace 1 isn't analysed for the spectrogram, so its history is stale when it comes back
+    const auto spectrogramEnabled = spectrogram.load();
+    if (spectrogramEnabled != appliedSpectrogram)
+    {
+        appliedSpectrogram = spectrogramEnabled;
+        pathGenerators[1].resetBallistics();
+        spectrogramPixels.clear();
+        lastSpectrogramRow = -1;
+    }
+
+    // The feed started over (prepareToPlay), so positions from before mean nothing
+    const auto generation = leftChannelRing->getGeneration();
+    if (generation != ringGeneration)
+    {
+        ringGeneration = generation;
+        lastWindowEnd = -1;
+        lastDecimatedPosition = -1;
+        lastSpectrogramRow = -1;
+
+        for (auto& ring : lowBandRings)
+            ring.reset();
 
-    while (leftChannelFifo->getNumCompleteBuffersAvailable() > 0)
+        for (auto& generator : pathGenerators)
+            generator.resetBallistics();
+    }
+
+    // Windows end on multiples of the hop size, so the analysis rate is
+    // sampleRate / hop no matter how the host slices its blocks. Only the newest
+    // window is ever drawn, so at most one is analysed per display frame, which
+    // caps the FFT rate at the display rate.
+    auto writePosition = juce::jmin(leftChannelRing->getWritePosition(), rightChannelRing->getWritePosition());
+    auto hop = (juce::int64)getHopSize();
+    auto windowEnd = writePosition - writePosition % hop;
+
+    if (windowEnd <= lastWindowEnd)
     {
-        if (leftChannelFifo->getAudioBuffer(tempIncomingBuffer))
+        // No new window, but the spectrogram keeps scrolling with the audio
+        if (spectrogramEnabled)
+            pushSpectrogramRows(writePosition, sampleRate);
+
+        return;
+    }
+
+    auto analysisStart = juce::Time::getMillisecondCounterHiRes();
+
+    // The low band has to see every sample, not just the analysed windows
+    const auto useLowBand = multiResolution.load() && sampleRate > 0.0;
+
+    if (useLowBand)
+        updateLowBand(writePosition, sampleRate);
+    else
+        lastDecimatedPosition = -1;
+
+    auto numSamples = analysisBuffer.getNumSamples();
+
+    if (!leftChannelRing->read(windowEnd, analysisBuffer.getWritePointer(0), numSamples)
+        || !rightChannelRing->read(windowEnd, analysisBuffer.getWritePointer(1), numSamples))
+        return;
+
+    // Reset while we were reading; the next call starts over
+    if (leftChannelRing->getGeneration() != ringGeneration)
+        return;
+
+    const auto frameSeconds = lastWindowEnd >= 0 ? float(double(windowEnd - lastWindowEnd) / sampleRate) : 0.f;
+
+    lastWindowEnd = windowEnd;
+    leftChannelRing->setReadPosition(windowEnd);
+    rightChannelRing->setReadPosition(windowEnd);
+
+    // The FFT doesn't care which two real signals it's given, so the other
+    // views are just a different pair: mid/side, or the sum on its own.
+    // The decimation is linear, so this works the same on the low band.
+    auto applyView = [currentView, numSamples](juce::AudioBuffer<float>& buffer)
         {
-            auto size = tempIncomingBuffer.getNumSamples();
+            auto* left = buffer.getWritePointer(0);
+            auto* right = buffer.getWritePointer(1);
+
+            if (currentView == AnalyzerView::MidSide)
+            {
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    auto mid = 0.5f * (left[i] + right[i]);
+                    auto side = 0.5f * (left[i] - right[i]);
+                    left[i] = mid;
+                    right[i] = side;
+                }
+            }
+            else if (currentView == AnalyzerView::Sum)
+            {
+                juce::FloatVectorOperations::add(left, right, numSamples);
+                juce::FloatVectorOperations::multiply(left, 0.5f, numSamples);
+            }
+        };
+
+    applyView(analysisBuffer);
+
+    const auto fftSize = fftDataGenerator.getFFTSize();
+    const auto binWidth = sampleRate / double(fftSize);
+    const auto numTraces = currentView == AnalyzerView::Sum || spectrogramEnabled ? 1 : 2;
 
-            juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, 0),
-                monoBuffer.getReadPointer(0, size),
-                monoBuffer.getNumSamples() - size);
+    fftDataGenerator.produceFFTDataForRendering(analysisBuffer, -48.f);
+    fftDataGenerator.getFFTData(fftData);
 
-            juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, monoBuffer.getNumSamples() - size),
-                tempIncomingBuffer.getReadPointer(0, 0),
-                size);
+    const float* lowBandData = nullptr;
 
+    if (useLowBand)
+    {
+        bool gotLowBand = true;
+
+        for (size_t ch = 0; ch < lowBandRings.size(); ++ch)
+        {
+            auto& ring = lowBandRings[ch];
+            auto lowBandEnd = ring.getWritePosition();
+            gotLowBand = ring.read(lowBandEnd, lowBandBuffer.getWritePointer((int)ch), numSamples) && gotLowBand;
+            ring.setReadPosition(lowBandEnd);
+        }
 
-            leftChannelFFTDataGenerator.produceFFTDataForRendering(monoBuffer, -48.f);
+        // A window that couldn't be read isn't worth analysing; this frame goes without
+        if (gotLowBand)
+        {
+            applyView(lowBandBuffer);
 
+            fftDataGenerator.produceFFTDataForRendering(lowBandBuffer, -48.f);
+            if (fftDataGenerator.getFFTData(lowBandFFTData))
+                lowBandData = lowBandFFTData.data();
         }
     }
 
-    const auto fftSize = leftChannelFFTDataGenerator.getFFTSize();
-    const auto binWidth = sampleRate / double(fftSize);
+    const auto lowBandBinWidth = float(binWidth / lowBandDecimation);
+    const auto crossoverFreq = getCrossoverFrequency(sampleRate);
+    const auto ballistics = getBallistics();
+
+    for (int trace = 0; trace < numTraces; ++trace)
+    {
+        auto offset = trace * fftSize / 2;
+        pathGenerators[(size_t)trace].generatePath(fftData.data() + offset,
+                                                   fftBounds, fftSize, (float)binWidth, -48.f,
+                                                   ballistics, frameSeconds,
+                                                   lowBandData != nullptr ? lowBandData + offset : nullptr,
+                                                   lowBandBinWidth, crossoverFreq);
+    }
+
+    if (spectrogramEnabled)
+    {
+        pathGenerators[0].getPixelLevels(spectrogramLevels, -48.f);
+        spectrogramPixels.resize(spectrogramLevels.size());
+
+        for (size_t x = 0; x < spectrogramLevels.size(); ++x)
+            spectrogramPixels[x] = Spectrogram::levelToPixel(spectrogramLevels[x], -48.f);
+
+        pushSpectrogramRows(writePosition, sampleRate);
+    }
+
+    if (autoStepDown)
+        updateAutoStepDown(juce::Time::getMillisecondCounterHiRes() - analysisStart);
+}
+
+
+void PathProducer::updateLowBand(juce::int64 writePosition, double sampleRate)
+{
+    if (sampleRate != lowBandSampleRate)
+    {
+        // After decimation, anything between fs_dec - crossover and fs_dec + crossover
+        // (and around every multiple of fs_dec) folds into 0..crossover, the only part
+        // of the low band that's shown. So the stopband has to start at fs_dec - crossover,
+        // three times the crossover, and clear the display's -48 dB floor there.
+        // An 8th order Butterworth at 1.25 times the crossover gives 62.5 dB at that
+        // point, and droops by 0.12 dB at the crossover itself.
+        auto crossover = (double)getCrossoverFrequency(sampleRate);
+        auto coefficients = juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(
+            float(1.25 * crossover), sampleRate, 8);
+
+        jassert(coefficients.size() == (int)lowBandFilters[0].size());
+
+        for (auto& channelFilters : lowBandFilters)
+            for (size_t i = 0; i < channelFilters.size(); ++i)
+                channelFilters[i].coefficients = coefficients[(int)i];
+
+        lowBandSampleRate = sampleRate;
+        lastDecimatedPosition = -1;
+    }
+
+    // Start over on the first frame, or if we fell too far behind to catch up
+    if (lastDecimatedPosition < 0 || writePosition - lastDecimatedPosition > leftChannelRing->getCapacity() / 2)
+    {
+        resetLowBandFilters();
+        lastDecimatedPosition = writePosition;
+        return;
+    }
 
-    while (leftChannelFFTDataGenerator.getNumAvailableFFTDataBlocks() > 0)
+    const auto chunkSize = analysisBuffer.getNumSamples();
+
+    while (lastDecimatedPosition < writePosition)
     {
-        std::vector<float> fftData;
-        if (leftChannelFFTDataGenerator.getFFTData(fftData))
+        auto numSamples = (int)juce::jmin((juce::int64)chunkSize, writePosition - lastDecimatedPosition);
+        auto chunkEnd = lastDecimatedPosition + numSamples;
+
+        if (!leftChannelRing->read(chunkEnd, analysisBuffer.getWritePointer(0), numSamples)
+            || !rightChannelRing->read(chunkEnd, analysisBuffer.getWritePointer(1), numSamples))
+        {
+            resetLowBandFilters();
+            lastDecimatedPosition = writePosition;
+            return;
+        }
+
+        for (size_t ch = 0; ch < lowBandFilters.size(); ++ch)
         {
-            pathProducer.generatePath(fftData, fftBounds, fftSize, binWidth, -48.f);
+            auto& filters = lowBandFilters[ch];
+            auto* input = analysisBuffer.getReadPointer((int)ch);
+            auto phase = decimationPhase;
+            int numDecimated = 0;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                auto v = input[i];
+                for (auto& filter : filters)
+                    v = filter.processSample(v);
+
+                if (++phase == lowBandDecimation)
+                {
+                    phase = 0;
+                    decimatedScratch[(size_t)numDecimated++] = v;
+                }
+            }
+
+            lowBandRings[ch].push(decimatedScratch.data(), numDecimated);
         }
+
+        decimationPhase = (decimationPhase + numSamples) % lowBandDecimation;
+        lastDecimatedPosition = chunkEnd;
+    }
+}
+
+
+void PathProducer::resetLowBandFilters()
+{
+    for (auto& channelFilters : lowBandFilters)
+        for (auto& filter : channelFilters)
+            filter.reset();
+
+    decimationPhase = 0;
+}
+
+
+void PathProducer::setBallistics(const AnalyzerBallistics& newBallistics)
+{
+    averagingSeconds = juce::jmax(0.f, newBallistics.averagingSeconds);
+    peakHold = newBallistics.peakHold;
+    smoothingOctaves = juce::jmax(0.f, newBallistics.smoothingOctaves);
+}
+
+
+AnalyzerBallistics PathProducer::getBallistics() const
+{
+    AnalyzerBallistics ballistics;
+    ballistics.averagingSeconds = averagingSeconds;
+    ballistics.peakHold = peakHold;
+    ballistics.smoothingOctaves = smoothingOctaves;
+    return ballistics;
+}
+
+
+void Spectrogram::setSize(int width, int height)
+{
+    if (width <= 0 || height <= 0)
+    {
+        image = {};
+        return;
+    }
+
+    if (image.isValid() && image.getWidth() == width && image.getHeight() == height)
+        return;
+
+    image = juce::Image(juce::Image::ARGB, width, height, true);
+    newestRow = 0;
+}
+
+
+void Spectrogram::clear()
+{
+    if (image.isValid())
+        image.clear(image.getBounds());
+
+    newestRow = 0;
+}
+
+
+void Spectrogram::addRow(const juce::uint32* pixels, int numPixels)
+{
+    // Rows analysed before a resize are just dropped
+    if (!image.isValid() || numPixels != image.getWidth())
+        return;
+
+    newestRow = (newestRow + image.getHeight() - 1) % image.getHeight();
+
+    juce::Image::BitmapData data(image, 0, newestRow, numPixels, 1, juce::Image::BitmapData::writeOnly);
+    jassert(data.pixelStride == (int)sizeof(juce::uint32));
+
+    std::memcpy(data.getLinePointer(0), pixels, (size_t)numPixels * sizeof(juce::uint32));
+}
+
+
+void Spectrogram::draw(juce::Graphics& g, juce::Rectangle<int> area) const
+{
+    if (!image.isValid())
+        return;
+
+    auto width = image.getWidth();
+    auto numNewer = image.getHeight() - newestRow;
+
+    // From the newest row down to the bottom of the image, then the rest from the top
+    g.drawImage(image, area.getX(), area.getY(), width, numNewer, 0, newestRow, width, numNewer);
+
+    if (newestRow > 0)
+        g.drawImage(image, area.getX(), area.getY() + numNewer, width, newestRow, 0, 0, width, newestRow);
+}
+
+
+const std::array<juce::uint32, 256>& Spectrogram::getColourMap()
+{
+    static const auto colourMap = []
+        {
+            using namespace juce;
+
+            ColourGradient gradient;
+            gradient.addColour(0.0, Colour(0x00376186));
+            gradient.addColour(0.4, Colour(0x88376186));
+            gradient.addColour(0.7, Colour(0xddff68a0));
+            gradient.addColour(0.9, Colours::orange);
+            gradient.addColour(1.0, Colours::lightyellow);
+
+            std::array<uint32, 256> map;
+
+            // getPixelARGB() is already premultiplied, which is what the image holds
+            for (size_t i = 0; i < map.size(); ++i)
+                map[i] = gradient.getColourAtPosition(double(i) / double(map.size() - 1)).getPixelARGB().getNativeARGB();
+
+            return map;
+        }();
+
+    return colourMap;
+}
+
+
+void PathProducer::pushSpectrogramRows(juce::int64 writePosition, double sampleRate)
+{
+    if (spectrogramPixels.empty() || sampleRate <= 0.0)
+        return;
+
+    const auto samplesPerRow = juce::jmax((juce::int64)1, (juce::int64)std::llround(sampleRate / spectrogramRowsPerSecond));
+    const auto row = writePosition / samplesPerRow;
+
+    // The first row after a reset just starts the count
+    auto numRows = lastSpectrogramRow >= 0 ? row - lastSpectrogramRow : (juce::int64)1;
+    lastSpectrogramRow = row;
+
+    // Every row due since the last call shows the newest frame. After a stall
+    // the FIFO fills up and the rest are dropped, rather than piling up.
+    for (; numRows > 0; --numRows)
+    {
+        auto* slot = spectrogramRows.beginWrite();
+
+        if (slot == nullptr)
+            break;
+
+        slot->assign(spectrogramPixels.begin(), spectrogramPixels.end());
+        spectrogramRows.finishWrite();
+    }
+}
+
+
+bool PathProducer::pullSpectrogramRows(Spectrogram& destination)
+{
+    bool gotNewRow = false;
+
+    while (spectrogramRows.pullBySwapping(spectrogramRow))
+    {
+        destination.addRow(spectrogramRow.data(), (int)spectrogramRow.size());
+        gotNewRow = true;
     }
 
-    while (pathProducer.getNumPathsAvailable() > 0)
+    return gotNewRow;
+}
+
+
+bool PathProducer::pullPaths()
+{
+    bool gotNewPath = false;
+
+    for (size_t trace = 0; trace < paths.size(); ++trace)
     {
-        pathProducer.getPath(leftChannelFFTPath);
+        while (pathGenerators[trace].getNumPathsAvailable() > 0)
+        {
+            gotNewPath = pathGenerators[trace].getPath(paths[trace]) || gotNewPath;
+        }
     }
 
+    return gotNewPath;
+}
+
+
+void PathProducer::applyOrder(FFTOrder newOrder)
+{
+    currentOrder = newOrder;
+    fftDataGenerator.changeOrder(newOrder);
+
+    // Only grows, so going back down to a smaller order doesn't allocate
+    auto fftSize = fftDataGenerator.getFFTSize();
+    analysisBuffer.setSize(2, fftSize, false, false, true);
+    lowBandBuffer.setSize(2, fftSize, false, false, true);
+    fftData.resize((size_t)fftSize, 0.f);
+    lowBandFFTData.resize((size_t)fftSize, 0.f);
+
+    averageAnalysisMs = -1.0;
+}
+
+
+void PathProducer::updateAutoStepDown(double analysisMs)
+{
+    averageAnalysisMs = averageAnalysisMs < 0.0 ? analysisMs
+                                                : 0.9 * averageAnalysisMs + 0.1 * analysisMs;
+
+    // Each step up more than doubles the cost, so stepping up only below a
+    // quarter of the budget keeps it from bouncing between two orders
+    if (averageAnalysisMs > analysisBudgetMs && currentOrder > FFTOrder::order2048)
+        applyOrder(static_cast<FFTOrder>(currentOrder - 1));
+    else if (averageAnalysisMs < 0.25 * analysisBudgetMs && currentOrder < appliedRequestedOrder)
+        applyOrder(static_cast<FFTOrder>(currentOrder + 1));
+}
+
+
+void PathProducer::setView(AnalyzerView newView)
+{
+    view = newView;
+
+    // Show the new view from its first frame rather than a stale trace
+    for (auto& path : paths)
+        path.clear();
+}
+
+
+void PathProducer::setOverlap(float newOverlap)
+{
+    // At least half, so a window never ends further back than the ring keeps
+    // (see analyzerMaxHopSize); past 7/8 every tick would be analysed anyway
+    overlap = juce::jlimit(0.5f, 0.875f, newOverlap);
+}
+
+
+int PathProducer::getHopSize() const
+{
+    auto fftSize = 1 << currentOrder.load();
+    return juce::jmax(1, juce::roundToInt((float)fftSize * (1.f - overlap)));
+}
+
+
+size_t PathProducer::getNumBytes() const
+{
+    size_t bytes = (size_t)(analysisBuffer.getNumChannels() + lowBandBuffer.getNumChannels())
+                       * (size_t)analysisBuffer.getNumSamples() * sizeof(float)
+                 + (fftData.size() + lowBandFFTData.size() + decimatedScratch.size()) * sizeof(float)
+                 + fftDataGenerator.getNumBytes();
+
+    for (const auto& ring : lowBandRings)
+        bytes += ring.getNumBytes();
 
+    return bytes;
 }
-void ResponseCurveComponent::timerCallback()
+void ResponseCurveComponent::onVBlank()
 {
+    // Nothing gets repainted unless something on screen actually changed
+    bool needsRepaint = false;
+
     if (shouldShowFFTAnalysis)
     {
-        auto fftBounds = getAnalysisArea().toFloat();
-        auto sampleRate = audioProcessor.getSampleRate();
+        // Take whatever the worker finished, then queue the next frame.
+        // If the last one is still running we just skip a frame.
+        needsRepaint = pathProducer.pullPaths();
+
+        if (pathProducer.pullSpectrogramRows(spectrogram))
+            needsRepaint = true;
+
+        if (!analysisWorkers->pool.contains(&analysisJob))
+        {
+            analysisJob.fftBounds = getAnalysisArea().toFloat();
+            analysisJob.sampleRate = audioProcessor.getSampleRate();
+            analysisWorkers->pool.addJob(&analysisJob, false);
+        }
+    }
 
-        leftPathProducer.process(fftBounds, sampleRate);
-        rightPathProducer.process(fftBounds, sampleRate);
+    if (parametersChanged.compareAndSetBool(false, true) && !hasUnpublishedChange)
+    {
+        hasUnpublishedChange = true;
+        unpublishedChangeTimeMs = juce::Time::getMillisecondCounter();
     }
 
-    if (parametersChanged.compareAndSetBool(false, true))
+    if (updateSnapshot())
     {
-        // Update the mono chain
-        updateChain();
         updateResponseCurve();
-        // Signal a repaint
-        //repaint();
+        needsRepaint = true;
     }
 
-    repaint();
+    // The grid, labels and border are cached and never change from frame to frame
+    if (needsRepaint)
+        repaint(getRenderArea());
 }
 
 
 
-void ResponseCurveComponent::updateChain()
+namespace
 {
-    auto chainSettings = getChainSettings(audioProcessor.apvts);
+    struct BandStages
+    {
+        int first, count;
+    };
+
+    // Which snapshot stages make up each of ResponseCurveComponent's bands
+    constexpr std::array<BandStages, 3> bandStages{ { { CoefficientSnapshot::lowCutStart, CoefficientSnapshot::numCutStages },
+                                                      { CoefficientSnapshot::peakStage, 1 },
+                                                      { CoefficientSnapshot::highCutStart, CoefficientSnapshot::numCutStages } } };
+}
 
-    monoChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-    monoChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
-    monoChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
 
+bool ResponseCurveComponent::updateSnapshot()
+{
+    const auto& published = audioProcessor.getPublishedCoefficients();
+    const auto now = juce::Time::getMillisecondCounter();
 
-    auto peakCoefficients = makePeakFilter(chainSettings, audioProcessor.getSampleRate());
-    updateCoefficients(monoChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+    CoefficientSnapshot newSnapshot;
 
-    auto lowCutCoefficients = makeLowCutFilter(chainSettings, audioProcessor.getSampleRate());
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, audioProcessor.getSampleRate());
+    if (published.getVersion() != snapshotVersion && published.read(newSnapshot, snapshotVersion))
+    {
+        hasUnpublishedChange = false;
+    }
+    else if (hasUnpublishedChange && now - unpublishedChangeTimeMs >= publishTimeoutMs
+             && audioProcessor.getSampleRate() > 0.0)
+    {
+        // The audio thread isn't running, so there's nobody to duplicate the work of
+        newSnapshot = makeCoefficientSnapshot(getChainSettings(audioProcessor.apvts), audioProcessor.getSampleRate());
+        hasUnpublishedChange = false;
+    }
+    else
+    {
+        return false;
+    }
 
-    updateCutFilter(monoChain.get<ChainPositions::LowCut>(), lowCutCoefficients, chainSettings.lowCutSlope);
-    updateCutFilter(monoChain.get<ChainPositions::HighCut>(), highCutCoefficients, chainSettings.highCutSlope);
+    for (size_t band = 0; band < bandCurves.size(); ++band)
+    {
+        for (int stage = bandStages[band].first; stage < bandStages[band].first + bandStages[band].count; ++stage)
+        {
+            if (newSnapshot.active[(size_t)stage] != snapshot.active[(size_t)stage]
+                || newSnapshot.stages[(size_t)stage] != snapshot.stages[(size_t)stage])
+                bandCurves[band].isDirty = true;
+        }
+    }
 
+    snapshot = newSnapshot;
+    return true;
 }
 
 
 
 
-void ResponseCurveComponent::updateResponseCurve()
+bool ResponseCurveEvaluator::prepare(int numColumns, double sampleRate)
 {
-    using namespace juce;
+    if (numColumns == getNumColumns() && sampleRate == preparedSampleRate)
+        return false;
 
-    auto responseArea = getAnalysisArea();
+    preparedSampleRate = sampleRate;
+    phis.resize((size_t)juce::jmax(numColumns, 0));
 
-    auto w = responseArea.getWidth();
+    if (sampleRate <= 0.0)
+        return true;
+
+    for (size_t i = 0; i < phis.size(); ++i)
+    {
+        auto freq = juce::mapToLog10(double(i) / double(phis.size()), 20.0, 20000.0);
+        auto halfOmega = juce::MathConstants<double>::pi * freq / sampleRate;
+        auto s = std::sin(halfOmega);
+        phis[i] = float(s * s);
+    }
+
+    return true;
+}
 
-    auto& lowCut = monoChain.get<ChainPositions::LowCut>();
-    auto& peak = monoChain.get<ChainPositions::Peak>();
-    auto& highCut = monoChain.get<ChainPositions::HighCut>();
 
-    auto sampleRate = audioProcessor.getSampleRate();
+void ResponseCurveEvaluator::evaluate(const CoefficientSnapshot& snapshot, int firstStage, int numStages, float* decibels) const
+{
+    const auto numColumns = phis.size();
+    const auto* phi = phis.data();
 
-    std::vector<double> mags;
+    // Accumulate log2 of the power response, stage by stage
+    std::fill(decibels, decibels + numColumns, 0.f);
 
-    mags.resize(w);
+    // Keeps the logs finite where a stage has a zero. abs() rather than a compare
+    // takes care of tiny negative rounding errors, because float compares stop the
+    // loop below from being vectorised unless trapping math is turned off.
+    constexpr float floor = 1.0e-30f;
 
-    for (int i = 0; i < w; i++)
+    for (auto stage = (size_t)firstStage; stage < (size_t)(firstStage + numStages); ++stage)
     {
-        double mag = 1.f;
-        auto freq = mapToLog10(double(i) / double(w), 20.0, 20000.0);
+        if (!snapshot.active[stage])
+            continue;
+
+        // The quadratic in phi for each side, worked out in double so that
+        // (b0 + b1 + b2)^2 stays accurate for the cut filters
+        const auto& c = snapshot.stages[stage];
+        const double b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[3], a2 = c[4];
 
-        if (!monoChain.isBypassed<ChainPositions::Peak>())
-            mag *= peak.coefficients->getMagnitudeForFrequency(freq, sampleRate);
+        const auto n0 = float((b0 + b1 + b2) * (b0 + b1 + b2));
+        const auto n1 = float(-4.0 * (b0 * b1 + b1 * b2 + 4.0 * b0 * b2));
+        const auto n2 = float(16.0 * b0 * b2);
 
-        if (!monoChain.isBypassed<ChainPositions::LowCut>())
+        const auto d0 = float((1.0 + a1 + a2) * (1.0 + a1 + a2));
+        const auto d1 = float(-4.0 * (a1 + a1 * a2 + 4.0 * a2));
+        const auto d2 = float(16.0 * a2);
+
+        for (size_t i = 0; i < numColumns; ++i)
         {
-            if (!lowCut.isBypassed<0>())
-                mag *= lowCut.get<0>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if (!lowCut.isBypassed<1>())
-                mag *= lowCut.get<1>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if (!lowCut.isBypassed<2>())
-                mag *= lowCut.get<2>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if (!lowCut.isBypassed<3>())
-                mag *= lowCut.get<3>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
+            auto num = n0 + phi[i] * (n1 + phi[i] * n2);
+            auto den = d0 + phi[i] * (d1 + phi[i] * d2);
+
+            num = std::abs(num) + floor;
+            den = std::abs(den) + floor;
+
+            decibels[i] += fastLog2(num) - fastLog2(den);
         }
+    }
+
+    for (size_t i = 0; i < numColumns; ++i)
+        decibels[i] *= decibelsPerPowerOctave;
+}
+
+
+
+void ResponseCurveComponent::updateResponseCurve()
+{
+    using namespace juce;
+
+    auto responseArea = getAnalysisArea();
 
-        if (!monoChain.isBypassed<ChainPositions::HighCut>())
+    auto w = responseArea.getWidth();
+
+    if (w <= 0)
+        return;
+
+    if (responseCurveEvaluator.prepare(w, snapshot.sampleRate))
+    {
+        for (auto& band : bandCurves)
         {
-            if (!highCut.isBypassed<0>())
-                mag *= highCut.get<0>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if (!highCut.isBypassed<1>())
-                mag *= highCut.get<1>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if (!highCut.isBypassed<2>())
-                mag *= highCut.get<2>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if (!highCut.isBypassed<3>())
-                mag *= highCut.get<3>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
+            band.decibels.resize((size_t)w);
+            band.isDirty = true;
         }
+    }
 
-        mags[i] = Decibels::gainToDecibels(mag);
+    // Only the bands that changed since last time get evaluated again.
+    // Bypassed stages are inactive in the snapshot, so they add nothing.
+    for (size_t band = 0; band < bandCurves.size(); ++band)
+    {
+        if (bandCurves[band].isDirty)
+        {
+            responseCurveEvaluator.evaluate(snapshot, bandStages[band].first, bandStages[band].count,
+                                            bandCurves[band].decibels.data());
+            bandCurves[band].isDirty = false;
+        }
     }
 
+    responseCurveDecibels.assign((size_t)w, 0.f);
+
+    for (const auto& band : bandCurves)
+        FloatVectorOperations::add(responseCurveDecibels.data(), band.decibels.data(), w);
+
+    FloatVectorOperations::clip(responseCurveDecibels.data(), responseCurveDecibels.data(), -100.f, 100.f, w);
 
     responseCurve.clear();
 
-    const double outputMin = responseArea.getBottom();
-    const double outputMax = responseArea.getY();
-    auto map = [outputMin, outputMax](double input)
+    const float outputMin = (float)responseArea.getBottom();
+    const float outputMax = (float)responseArea.getY();
+    auto map = [outputMin, outputMax](float input)
     {
-		return jmap(input, -24.0, 24.0, outputMin, outputMax);
+		return jmap(input, -24.f, 24.f, outputMin, outputMax);
 	};
 
-    responseCurve.lineTo(responseArea.getX(), map(mags.front()));
+    responseCurvePoints.resize(responseCurveDecibels.size());
+
+    for (size_t i = 0; i < responseCurveDecibels.size(); i++)
+    {
+        responseCurvePoints[i] = { (float)responseArea.getX() + (float)i, map(responseCurveDecibels[i]) };
+    }
+
+    // Long stretches of the curve are straight or gently bent, so this drops most of the points
+    auto numPoints = simplifyPolyline(responseCurvePoints.data(), responseCurvePoints.size(), pathSimplificationTolerance);
 
-    for (size_t i = 1; i < mags.size(); i++)
+    responseCurve.startNewSubPath(responseCurvePoints[0]);
+
+    for (size_t i = 1; i < numPoints; i++)
     {
-        responseCurve.lineTo(responseArea.getX() + i, map(mags[i]));
+        responseCurve.lineTo(responseCurvePoints[i]);
     }
 }
 
@@ -469,51 +1162,84 @@ void ResponseCurveComponent::paint(juce::Graphics& g)
 {
     using namespace juce;
 
-    g.fillAll(Colour(0xff182a3a));
+    // The grid, labels and border only change on resize, so they're drawn
+    // once into images at the display's pixel density and just blitted here
+    auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
 
-    //g.drawImage(background, getLocalBounds().toFloat());
+    if (scale != layerScale || !backgroundLayer.isValid())
+        renderLayers(scale);
 
-    drawBackgroundGrid(g);
+    g.drawImage(backgroundLayer, getLocalBounds().toFloat());
 
     auto responseArea = getAnalysisArea();
 
     // Frequency Spectrum Analyzer
-    if (shouldShowFFTAnalysis)
+    if (shouldShowFFTAnalysis && pathProducer.isSpectrogramEnabled())
+    {
+        spectrogram.draw(g, responseArea);
+    }
+    else if (shouldShowFFTAnalysis)
     {
-        // Left Channel
-        auto leftChannelFFTPath = leftPathProducer.getPath();
-        leftChannelFFTPath.applyTransform(AffineTransform().translation(responseArea.getX(), responseArea.getY()));
+        // The paths are drawn through a transform rather than copied and moved
+        auto toAnalysisArea = AffineTransform::translation((float)responseArea.getX(), (float)responseArea.getY());
 
+        // Left, Mid or Sum
         g.setColour(Colours::lightskyblue);
-        g.strokePath(leftChannelFFTPath, PathStrokeType(1.f));
-
-        // Right Channel
-        auto rightChannelFFTPath = rightPathProducer.getPath();
-        rightChannelFFTPath.applyTransform(AffineTransform().translation(responseArea.getX(), responseArea.getY()));
+        g.strokePath(pathProducer.getPath(0), PathStrokeType(1.f), toAnalysisArea);
 
+        // Right or Side
         g.setColour(Colours::seagreen);
-        g.strokePath(rightChannelFFTPath, PathStrokeType(1.f));
+        g.strokePath(pathProducer.getPath(1), PathStrokeType(1.f), toAnalysisArea);
 
     }
 
     g.setColour(Colours::white);
     g.strokePath(responseCurve, PathStrokeType(2.f));
 
-    Path border;
+    // Covers whatever the curves drew outside the render area
+    g.drawImage(foregroundLayer, getLocalBounds().toFloat());
+}
+
+
+
+void ResponseCurveComponent::renderLayers(float scale)
+{
+    using namespace juce;
+
+    layerScale = scale;
+
+    auto w = jmax(1, roundToInt((float)getWidth() * scale));
+    auto h = jmax(1, roundToInt((float)getHeight() * scale));
 
-    border.setUsingNonZeroWinding(false);
+    backgroundLayer = Image(Image::RGB, w, h, false);
+    {
+        Graphics g(backgroundLayer);
+        g.addTransform(AffineTransform::scale(scale));
+
+        g.fillAll(Colour(0xff182a3a));
+        drawBackgroundGrid(g);
+    }
+
+    foregroundLayer = Image(Image::ARGB, w, h, true);
+    {
+        Graphics g(foregroundLayer);
+        g.addTransform(AffineTransform::scale(scale));
+
+        Path border;
 
-    border.addRoundedRectangle(getRenderArea(), 4.f);
-    border.addRectangle(getLocalBounds());
+        border.setUsingNonZeroWinding(false);
 
-    g.setColour(Colour(0xff182a3a));
-    g.fillPath(border);
+        border.addRoundedRectangle(getRenderArea(), 4.f);
+        border.addRectangle(getLocalBounds());
 
-    drawTextLabels(g);
+        g.setColour(Colour(0xff182a3a));
+        g.fillPath(border);
 
-    g.setColour(Colour(0xffff68a0));
-    g.drawRoundedRectangle(getRenderArea().toFloat(), 4.f, 1.f);
+        drawTextLabels(g);
 
+        g.setColour(Colour(0xffff68a0));
+        g.drawRoundedRectangle(getRenderArea().toFloat(), 4.f, 1.f);
+    }
 }
 
 
@@ -672,6 +1398,106 @@ void ResponseCurveComponent::resized()
 
     responseCurve.preallocateSpace(getWidth() * 3);
     updateResponseCurve();
+
+    auto analysisArea = getAnalysisArea();
+    spectrogram.setSize(analysisArea.getWidth(), analysisArea.getHeight());
+
+    // Drawn again at the next paint, once we know the scale it's painted at
+    backgroundLayer = {};
+    foregroundLayer = {};
+}
+
+
+
+void ResponseCurveComponent::mouseDown(const juce::MouseEvent& e)
+{
+    using namespace juce;
+
+    if (!e.mods.isPopupMenu())
+        return;
+
+    auto currentView = pathProducer.getView();
+
+    PopupMenu menu;
+    menu.addItem("Left / Right", true, currentView == AnalyzerView::LeftRight,
+                 [this] { pathProducer.setView(AnalyzerView::LeftRight); });
+    menu.addItem("Mid / Side", true, currentView == AnalyzerView::MidSide,
+                 [this] { pathProducer.setView(AnalyzerView::MidSide); });
+    menu.addItem("Sum", true, currentView == AnalyzerView::Sum,
+                 [this] { pathProducer.setView(AnalyzerView::Sum); });
+
+    menu.addSeparator();
+    menu.addItem("Spectrogram", true, pathProducer.isSpectrogramEnabled(),
+                 [this] { setSpectrogramEnabled(!pathProducer.isSpectrogramEnabled()); });
+
+    PopupMenu resolution;
+    for (auto order : { FFTOrder::order2048, FFTOrder::order4096, FFTOrder::order8192 })
+    {
+        resolution.addItem(String(1 << order) + " points", true, pathProducer.getOrder() == order,
+                           [this, order] { pathProducer.setOrder(order); });
+    }
+
+    resolution.addSeparator();
+    resolution.addItem("Finer low end", true, pathProducer.isMultiResolutionEnabled(),
+                       [this] { pathProducer.setMultiResolution(!pathProducer.isMultiResolutionEnabled()); });
+    resolution.addItem("Reduce when busy", true, pathProducer.isAutoStepDownEnabled(),
+                       [this] { pathProducer.setAutoStepDown(!pathProducer.isAutoStepDownEnabled()); });
+
+    // More overlap means more frames per second from the same FFT size
+    PopupMenu overlap;
+    for (auto amount : { 0.5f, 0.75f, 0.875f })
+    {
+        overlap.addItem(String(amount * 100.f, amount == 0.875f ? 1 : 0) + "%", true, pathProducer.getOverlap() == amount,
+                        [this, amount] { pathProducer.setOverlap(amount); });
+    }
+
+    menu.addSeparator();
+    menu.addSubMenu("Resolution", resolution);
+    menu.addSubMenu("Overlap", overlap);
+
+    auto ballistics = pathProducer.getBallistics();
+
+    auto setBallistics = [this](auto change)
+        {
+            auto newBallistics = pathProducer.getBallistics();
+            change(newBallistics);
+            pathProducer.setBallistics(newBallistics);
+        };
+
+    PopupMenu averaging;
+    for (auto seconds : { 0.f, 0.1f, 0.3f, 1.f })
+    {
+        auto name = seconds > 0.f ? String(roundToInt(seconds * 1000.f)) + " ms" : String("Off");
+        averaging.addItem(name, true, ballistics.averagingSeconds == seconds,
+                          [setBallistics, seconds] { setBallistics([seconds](AnalyzerBallistics& b) { b.averagingSeconds = seconds; }); });
+    }
+
+    PopupMenu smoothing;
+    for (auto fraction : { 0, 24, 12, 6, 3 })
+    {
+        auto octaves = fraction > 0 ? 1.f / (float)fraction : 0.f;
+        auto name = fraction > 0 ? "1/" + String(fraction) + " octave" : String("Off");
+        smoothing.addItem(name, true, ballistics.smoothingOctaves == octaves,
+                          [setBallistics, octaves] { setBallistics([octaves](AnalyzerBallistics& b) { b.smoothingOctaves = octaves; }); });
+    }
+
+    menu.addSubMenu("Averaging", averaging);
+    menu.addSubMenu("Smoothing", smoothing);
+    menu.addItem("Peak hold", true, ballistics.peakHold,
+                 [setBallistics] { setBallistics([](AnalyzerBallistics& b) { b.peakHold = !b.peakHold; }); });
+
+    // Attached to us, so the menu dismisses itself if the editor closes while it's open
+    menu.showMenuAsync(PopupMenu::Options().withTargetComponent(this));
+}
+
+
+void ResponseCurveComponent::setSpectrogramEnabled(bool enabled)
+{
+    pathProducer.setSpectrogram(enabled);
+
+    // Starts scrolling from empty rather than from whatever it showed last time
+    spectrogram.clear();
+    repaint(getRenderArea());
 }
 
 
@@ -704,6 +1530,167 @@ juce::Rectangle<int> ResponseCurveComponent::getAnalysisArea()
 
 
 
+//==============================================================================
+
+PresetBrowser::PresetBrowser(SimpleQAudioProcessor& p) :
+    audioProcessor(p)
+{
+    searchBox.setTextToShowWhenEmpty("Search or name, #tags", juce::Colours::grey);
+    // Return doesn't save: it would overwrite whatever preset was just searched for
+    searchBox.onTextChange = [this]() { refresh(); };
+
+    saveButton.onClick = [this]() { saveCurrentSettings(); };
+
+    list.setModel(this);
+    list.setRowHeight(18);
+    list.setColour(juce::ListBox::backgroundColourId, juce::Colour(0xff182a3a));
+
+    addAndMakeVisible(searchBox);
+    addAndMakeVisible(saveButton);
+    addAndMakeVisible(list);
+
+    library->addChangeListener(this);
+}
+
+
+
+PresetBrowser::~PresetBrowser()
+{
+    library->removeChangeListener(this);
+}
+
+
+
+void PresetBrowser::parseQuery(juce::String& name, juce::StringArray& tags) const
+{
+    juce::StringArray nameWords;
+
+    for (const auto& word : juce::StringArray::fromTokens(searchBox.getText(), false))
+    {
+        if (word.startsWithChar('#'))
+        {
+            if (word.length() > 1)
+                tags.add(word.substring(1));
+        }
+        else if (word.isNotEmpty())
+        {
+            nameWords.add(word);
+        }
+    }
+
+    name = nameWords.joinIntoString(" ");
+}
+
+
+
+void PresetBrowser::refresh()
+{
+    juce::String name;
+    juce::StringArray tags;
+    parseQuery(name, tags);
+
+    matches = library->find(name, tags);
+
+    list.updateContent();
+    list.deselectAllRows();
+    list.repaint();
+}
+
+
+
+void PresetBrowser::saveCurrentSettings()
+{
+    PresetLibrary::Preset preset;
+    parseQuery(preset.name, preset.tags);
+
+    if (preset.name.isEmpty())
+        return;
+
+    preset.settings = getChainSettings(audioProcessor.apvts);
+
+    if (!library->hasRoomForTags(preset))
+    {
+        juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::WarningIcon, "Preset not saved",
+                                               "The library can only hold " + juce::String(PresetLibrary::maxNumTags)
+                                               + " different tags. Use some of the existing ones instead.", {}, this);
+        return;
+    }
+
+    // Every browser, this one included, refreshes from the change message
+    if (!library->save(preset))
+    {
+        juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::WarningIcon, "Preset not saved",
+                                               "Couldn't write " + PresetLibrary::getDefaultFile().getFullPathName(), {}, this);
+    }
+}
+
+
+
+void PresetBrowser::paintListBoxItem(int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected)
+{
+    using namespace juce;
+
+    if (!isPositiveAndBelow(rowNumber, matches.size()))
+        return;
+
+    // Only the visible rows ever get their name and tags decoded
+    auto index = matches[rowNumber];
+
+    if (rowIsSelected)
+        g.fillAll(Colour(0x66ff68a0));
+
+    auto bounds = Rectangle<int>(0, 0, width, height).reduced(4, 0);
+
+    g.setFont(12.f);
+    g.setColour(Colours::white);
+    g.drawText(library->getName(index), bounds, Justification::centredLeft, true);
+
+    String tags;
+    auto mask = library->getTagMask(index);
+    const auto& tagNames = library->getTagNames();
+    for (int i = 0; i < tagNames.size(); ++i)
+        if ((mask & (1u << i)) != 0)
+            tags << "#" << tagNames[i] << " ";
+
+    g.setColour(Colour(0xff376186));
+    g.drawText(tags.trimEnd(), bounds, Justification::centredRight, true);
+}
+
+
+
+void PresetBrowser::listBoxItemClicked(int row, const juce::MouseEvent&)
+{
+    if (juce::isPositiveAndBelow(row, matches.size()))
+        audioProcessor.morphTo(library->getSettings(matches[row]));
+}
+
+
+
+void PresetBrowser::paint(juce::Graphics& g)
+{
+    g.fillAll(juce::Colour(0xff182a3a));
+
+    g.setColour(juce::Colour(0xffff68a0));
+    g.drawRoundedRectangle(getLocalBounds().toFloat().reduced(0.5f), 4.f, 1.f);
+}
+
+
+
+void PresetBrowser::resized()
+{
+    auto bounds = getLocalBounds().reduced(4);
+
+    auto top = bounds.removeFromTop(22);
+    saveButton.setBounds(top.removeFromRight(50));
+    top.removeFromRight(4);
+    searchBox.setBounds(top);
+
+    bounds.removeFromTop(4);
+    list.setBounds(bounds);
+}
+
+
+
 //==============================================================================
 SimpleQAudioProcessorEditor::SimpleQAudioProcessorEditor (SimpleQAudioProcessor& p)
     : AudioProcessorEditor (&p), audioProcessor (p),
@@ -727,7 +1714,9 @@ SimpleQAudioProcessorEditor::SimpleQAudioProcessorEditor (SimpleQAudioProcessor&
     lowCutBypassButtonAttachment(audioProcessor.apvts, "LowCut Bypassed", lowCutBypassButton),
     peakBypassButtonAttachment(audioProcessor.apvts, "Peak Bypassed", peakBypassButton),
     highCutBypassButtonAttachment(audioProcessor.apvts, "HighCut Bypassed", highCutBypassButton),
-    analyzerEnabledButtonAttachment(audioProcessor.apvts, "Analyzer Enabled", analyzerEnabledButton)
+    analyzerEnabledButtonAttachment(audioProcessor.apvts, "Analyzer Enabled", analyzerEnabledButton),
+    morphTimeSliderAttachment(audioProcessor.apvts, "Morph Time", morphTimeSlider),
+    presetBrowser(audioProcessor)
 {
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
@@ -762,6 +1751,13 @@ SimpleQAudioProcessorEditor::SimpleQAudioProcessorEditor (SimpleQAudioProcessor&
 		addAndMakeVisible(comp);
 	}
 
+    // All of them share the one look and feel, and with it its cached knob faces and glyphs
+    for (auto* slider : { &peakFreqSlider, &peakGainSlider, &peakQualitySlider, &lowCutFreqSlider,
+                          &highCutFreqSlider, &lowCutSlopeSlider, &highCutSlopeSlider })
+    {
+        slider->setLookAndFeel(&lnf);
+    }
+
     peakBypassButton.setLookAndFeel(&lnf);
     lowCutBypassButton.setLookAndFeel(&lnf);
     highCutBypassButton.setLookAndFeel(&lnf);
@@ -815,17 +1811,96 @@ SimpleQAudioProcessorEditor::SimpleQAudioProcessorEditor (SimpleQAudioProcessor&
         };
 
 
+    for (int i = 0; i < audioProcessor.getNumPrograms(); ++i)
+        programBox.addItem(audioProcessor.getProgramName(i), i + 1);
+
+    programBox.setSelectedId(audioProcessor.getCurrentProgram() + 1, juce::dontSendNotification);
+    programBox.setTextWhenNothingSelected("Program");
+
+    programBox.onChange = [safePtr]()
+        {
+            if (auto* comp = safePtr.getComponent())
+            {
+                auto index = comp->programBox.getSelectedId() - 1;
+                if (index >= 0)
+                    comp->audioProcessor.setCurrentProgram(index);
+            }
+        };
+
+    morphTimeSlider.setTextValueSuffix(" ms");
+    morphTimeSlider.setTooltip("Morph Time");
+
+    abSlotAButton.setClickingTogglesState(false);
+    abSlotBButton.setClickingTogglesState(false);
+    abSlotAButton.setColour(juce::TextButton::buttonOnColourId, juce::Colour(0xffff68a0));
+    abSlotBButton.setColour(juce::TextButton::buttonOnColourId, juce::Colour(0xffff68a0));
+
+    abSlotAButton.onClick = [safePtr]()
+        {
+            if (auto* comp = safePtr.getComponent())
+            {
+                comp->audioProcessor.switchToABSlot(SimpleQAudioProcessor::SlotA);
+                comp->updateABButtons();
+            }
+        };
+
+    abSlotBButton.onClick = [safePtr]()
+        {
+            if (auto* comp = safePtr.getComponent())
+            {
+                comp->audioProcessor.switchToABSlot(SimpleQAudioProcessor::SlotB);
+                comp->updateABButtons();
+            }
+        };
+
+    updateABButtons();
+    audioProcessor.addChangeListener(this);
+
+    // The library browser sits on top of the response curve while it's open
+    addChildComponent(presetBrowser);
 
+    libraryButton.setClickingTogglesState(true);
+    libraryButton.setColour(juce::TextButton::buttonOnColourId, juce::Colour(0xffff68a0));
+    libraryButton.onClick = [safePtr]()
+        {
+            if (auto* comp = safePtr.getComponent())
+            {
+                auto show = comp->libraryButton.getToggleState();
+                if (show)
+                    comp->presetBrowser.refresh();
+
+                comp->presetBrowser.setVisible(show);
+            }
+        };
 
 
 
 
 
     setSize (600, 480);
+
+   #if SIMPLEQ_ENABLE_PROFILING
+    juce::String memoryReport;
+    memoryReport << "SimpleQ memory report" << juce::newLine
+                 << audioProcessor.getMemoryReport()
+                 << responseCurveComponent.getAnalyzerMemoryReport();
+    juce::Logger::writeToLog(memoryReport);
+
+    juce::Logger::writeToLog("SimpleQ editor constructed in "
+                             + juce::String(juce::Time::getMillisecondCounterHiRes() - openStartMs, 2) + " ms");
+   #endif
 }
 
 SimpleQAudioProcessorEditor::~SimpleQAudioProcessorEditor()
 {
+    audioProcessor.removeChangeListener(this);
+
+    for (auto* slider : { &peakFreqSlider, &peakGainSlider, &peakQualitySlider, &lowCutFreqSlider,
+                          &highCutFreqSlider, &lowCutSlopeSlider, &highCutSlopeSlider })
+    {
+        slider->setLookAndFeel(nullptr);
+    }
+
     peakBypassButton.setLookAndFeel(nullptr);
     lowCutBypassButton.setLookAndFeel(nullptr);
     highCutBypassButton.setLookAndFeel(nullptr);
@@ -839,6 +1914,15 @@ void SimpleQAudioProcessorEditor::paint(juce::Graphics& g)
 
     g.fillAll(Colour(0xff182a3a));
 
+   #if SIMPLEQ_ENABLE_PROFILING
+    // From the start of the constructor to the first frame being drawn
+    if (!hasReportedOpenTime)
+    {
+        hasReportedOpenTime = true;
+        Logger::writeToLog("SimpleQ editor first paint after "
+                           + String(Time::getMillisecondCounterHiRes() - openStartMs, 2) + " ms");
+    }
+   #endif
 }
 
 void SimpleQAudioProcessorEditor::resized()
@@ -855,6 +1939,18 @@ void SimpleQAudioProcessorEditor::resized()
 
     analyzerEnabledButton.setBounds(analyzerEnabledArea);
 
+    auto programArea = juce::Rectangle<int>(0, 2, getWidth(), 21);
+    programArea.removeFromRight(5);
+    abSlotBButton.setBounds(programArea.removeFromRight(25));
+    programArea.removeFromRight(2);
+    abSlotAButton.setBounds(programArea.removeFromRight(25));
+    programArea.removeFromRight(5);
+    morphTimeSlider.setBounds(programArea.removeFromRight(90));
+    programArea.removeFromRight(5);
+    programBox.setBounds(programArea.removeFromRight(160));
+    programArea.removeFromRight(5);
+    libraryButton.setBounds(programArea.removeFromRight(60));
+
     bounds.removeFromTop(5);
 
 
@@ -863,6 +1959,7 @@ void SimpleQAudioProcessorEditor::resized()
     // Area for the frequency response graph (top 1/3 of the bounds)
     auto responseArea = bounds.removeFromTop(static_cast<int>(bounds.getHeight() * hRatio));
     responseCurveComponent.setBounds(responseArea);
+    presetBrowser.setBounds(responseArea);
 
     bounds.removeFromTop(5);
 
@@ -916,7 +2013,12 @@ std::vector<juce::Component*> SimpleQAudioProcessorEditor::getComps()
         &lowCutBypassButton,
         &peakBypassButton,
         &highCutBypassButton,
-        &analyzerEnabledButton
+        &analyzerEnabledButton,
+        &programBox,
+        &morphTimeSlider,
+        &abSlotAButton,
+        &abSlotBButton,
+        &libraryButton
 
 
 
@@ -925,3 +2027,19 @@ std::vector<juce::Component*> SimpleQAudioProcessorEditor::getComps()
 
 	};
 }
+
+
+void SimpleQAudioProcessorEditor::changeListenerCallback(juce::ChangeBroadcaster*)
+{
+    programBox.setSelectedId(audioProcessor.getCurrentProgram() + 1, juce::dontSendNotification);
+    updateABButtons();
+}
+
+
+void SimpleQAudioProcessorEditor::updateABButtons()
+{
+    auto slot = audioProcessor.getCurrentABSlot();
+
+    abSlotAButton.setToggleState(slot == SimpleQAudioProcessor::SlotA, juce::dontSendNotification);
+    abSlotBButton.setToggleState(slot == SimpleQAudioProcessor::SlotB, juce::dontSendNotification);
+}
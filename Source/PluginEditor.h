@@ -10,6 +10,7 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "PresetLibrary.h"
 
 
 
@@ -20,107 +21,361 @@ enum FFTOrder
     order8192 = 13
 };
 
+constexpr int numFFTOrders = FFTOrder::order8192 - FFTOrder::order2048 + 1;
+
+static_assert((1 << FFTOrder::order8192) <= analyzerMaxWindowSize,
+              "the analyzer feed has to keep at least one window of the largest FFT");
+
+// log2 of a positive, finite float: the float's exponent plus a quartic fit of log2
+// over the mantissa's [1, 2) range, within about 0.00035 of the exact value.
+// It's branch-free, so the compiler is free to vectorise loops around it.
+inline float fastLog2(float x)
+{
+    juce::uint32 bits;
+    std::memcpy(&bits, &x, sizeof(float));
+
+    auto exponent = (float)((int)(bits >> 23) - 127);
+
+    bits = (bits & 0x007fffffu) | 0x3f800000u;
+    float mantissa;
+    std::memcpy(&mantissa, &bits, sizeof(float));
+
+    auto t = mantissa - 1.f;
+    return exponent + t * (1.4420680f + t * (-0.70077810f + t * (0.36401877f + t * -0.10565924f)));
+}
+
+// 10 * log10(2), turns fastLog2 of a power ratio into decibels
+constexpr float decibelsPerPowerOctave = 3.0103000f;
+
+// 10 * log10(power), clamped to negativeInfinity, with NaN and inf reading as silence.
+// Stays within about 0.001 dB of the exact value.
+inline float fastPowerToDecibels(float power, float negativeInfinity)
+{
+    power = power < std::numeric_limits<float>::infinity() ? power : 0.f;
+
+    auto dB = decibelsPerPowerOctave * fastLog2(power);
+    return dB > negativeInfinity ? dB : negativeInfinity;
+}
+
+// How far, in pixels, a drawn line may stray from the points it was simplified from.
+// Below half a pixel the difference doesn't survive antialiasing; 0 keeps every point.
+constexpr float pathSimplificationTolerance = 0.25f;
+
+// Removes points from a polyline whose x only ever increases, so that no removed point
+// is further than 'tolerance' (measured vertically, which bounds the true distance)
+// from the segment that replaces it. One pass: from each kept point it narrows the
+// range of slopes that keeps every point since in tolerance, and keeps the previous
+// point once the next one needs a slope outside it.
+// Compacts 'points' in place and returns how many are left; the ends are always kept.
+inline size_t simplifyPolyline(juce::Point<float>* points, size_t numPoints, float tolerance)
+{
+    if (numPoints < 3 || tolerance <= 0.f)
+        return numPoints;
+
+    auto anchor = points[0];
+    auto previous = points[0];
+    auto minSlope = -std::numeric_limits<float>::infinity();
+    auto maxSlope = std::numeric_limits<float>::infinity();
+    bool previousIsAnchor = true;
+    size_t numKept = 1;
+
+    for (size_t i = 1; i < numPoints; ++i)
+    {
+        auto point = points[i];
+        auto dx = point.x - anchor.x;
+
+        // A step straight up or down can't be bridged, so both ends stay
+        if (dx <= 0.f)
+        {
+            if (!previousIsAnchor)
+                points[numKept++] = previous;
+
+            points[numKept++] = point;
+            anchor = previous = point;
+            minSlope = -std::numeric_limits<float>::infinity();
+            maxSlope = std::numeric_limits<float>::infinity();
+            previousIsAnchor = true;
+            continue;
+        }
+
+        auto slope = (point.y - anchor.y) / dx;
+
+        if (!previousIsAnchor && (slope < minSlope || slope > maxSlope))
+        {
+            points[numKept++] = previous;
+            anchor = previous;
+            dx = point.x - anchor.x;
+            minSlope = -std::numeric_limits<float>::infinity();
+            maxSlope = std::numeric_limits<float>::infinity();
+        }
+
+        minSlope = juce::jmax(minSlope, (point.y - tolerance - anchor.y) / dx);
+        maxSlope = juce::jmin(maxSlope, (point.y + tolerance - anchor.y) / dx);
+
+        previous = point;
+        previousIsAnchor = false;
+    }
+
+    // Unless the last point was a step, which kept it already
+    if (!previousIsAnchor)
+        points[numKept++] = previous;
+
+    return numKept;
+}
+
+
+// The FFT engines and their window tables, one per order for the whole process.
+// Once built they're only ever read (juce::dsp::FFT::perform() is const), so every
+// analyzer shares them, and an editor opening after the first doesn't build any.
+// Each is built the first time it's asked for, on the analysis worker asking.
+struct FFTPlans
+{
+    struct Plan
+    {
+        std::unique_ptr<juce::dsp::FFT> fft;
+        std::vector<float> windowTable;
+    };
+
+    const Plan& get(FFTOrder order)
+    {
+        const juce::ScopedLock sl(lock);
+
+        auto& plan = plans[(size_t)(order - FFTOrder::order2048)];
+
+        if (plan == nullptr)
+        {
+            auto fftSize = (size_t)1 << order;
+
+            plan = std::make_unique<Plan>();
+            plan->fft = std::make_unique<juce::dsp::FFT>(order);
+            plan->windowTable.resize(fftSize);
+            juce::dsp::WindowingFunction<float>::fillWindowingTables(plan->windowTable.data(), fftSize,
+                                                                     juce::dsp::WindowingFunction<float>::blackmanHarris);
+        }
+
+        return *plan;
+    }
+
+private:
+    juce::CriticalSection lock;
+    std::array<std::unique_ptr<Plan>, numFFTOrders> plans;
+};
+
+
 template<typename BlockType>
 struct FFTDataGenerator
 {
     /**
      produces the FFT data from an audio buffer.
+
+     Both channels go through a single complex FFT: channel 0 as the real part
+     and channel 1 as the imaginary part. Because each input is real, its
+     spectrum is conjugate-symmetric, so they can be separated afterwards:
+        A[k] = (Z[k] + conj(Z[N - k])) / 2
+        B[k] = (Z[k] - conj(Z[N - k])) / 2i
+     A frame holds A's bins in [0, N/2) and B's bins in [N/2, N).
+     A mono buffer leaves the second half at negativeInfinity.
      */
     void produceFFTDataForRendering(const juce::AudioBuffer<float>& audioData, const float negativeInfinity)
     {
         const auto fftSize = getFFTSize();
 
-        fftData.assign(fftData.size(), 0);
-        auto* readIndex = audioData.getReadPointer(0);
-        std::copy(readIndex, readIndex + fftSize, fftData.begin());
+        // Render straight into the FIFO slot rather than copying a finished frame in
+        auto* slot = fftDataFifo.beginWrite();
+        if (slot == nullptr)
+            return;
+
+        auto& fftData = *slot;
+
+        // Slots swapped out by the reader come back from before an order change
+        fftData.resize(fftSize);
+
+        // first apply a windowing function to our data, packing both channels as we go
+        auto* a = audioData.getReadPointer(0);
+        auto* b = audioData.getNumChannels() > 1 ? audioData.getReadPointer(1) : nullptr;
+
+        const auto* windowTable = plan->windowTable.data();
 
-        // first apply a windowing function to our data
-        window->multiplyWithWindowingTable(fftData.data(), fftSize);       // [1]
+        for (int i = 0; i < fftSize; ++i)
+            complexData[(size_t)i] = { a[i] * windowTable[i], b != nullptr ? b[i] * windowTable[i] : 0.f };
 
         // then render our FFT data..
-        forwardFFT->performFrequencyOnlyForwardTransform(fftData.data());  // [2]
+        plan->fft->perform(complexData.data(), complexData.data(), false);
 
         int numBins = (int)fftSize / 2;
 
-        //normalize the fft values.
-        for (int i = 0; i < numBins; ++i)
-        {
-            auto v = fftData[i];
-            //            fftData[i] /= (float) numBins;
-            if (!std::isinf(v) && !std::isnan(v))
-            {
-                v /= float(numBins);
-            }
-            else
-            {
-                v = 0.f;
-            }
-            fftData[i] = v;
-        }
+        // separate the channels, normalize and convert to decibels in one pass.
+        // Working on the squared magnitude saves the square root: the 1/2 from the
+        // separation and the 1/numBins normalization become a single power scale.
+        const auto powerScale = 0.25f / (float(numBins) * float(numBins));
+        const auto* z = reinterpret_cast<const float*>(complexData.data());
+        auto* out = fftData.data();
 
-        //convert them to decibels
         for (int i = 0; i < numBins; ++i)
         {
-            fftData[i] = juce::Decibels::gainToDecibels(fftData[i], negativeInfinity);
+            auto k = 2 * i;
+            auto m = 2 * ((fftSize - i) & (fftSize - 1));
+
+            // z[k] + conj(z[N - k]) and z[k] - conj(z[N - k])
+            auto sumRe = z[k] + z[m], sumIm = z[k + 1] - z[m + 1];
+            auto diffRe = z[k] - z[m], diffIm = z[k + 1] + z[m + 1];
+
+            out[i] = fastPowerToDecibels((sumRe * sumRe + sumIm * sumIm) * powerScale, negativeInfinity);
+            out[numBins + i] = fastPowerToDecibels((diffRe * diffRe + diffIm * diffIm) * powerScale, negativeInfinity);
         }
 
-        fftDataFifo.push(fftData);
+        if (b == nullptr)
+            std::fill(fftData.begin() + numBins, fftData.end(), negativeInfinity);
+
+        fftDataFifo.finishWrite();
     }
 
     void changeOrder(FFTOrder newOrder)
     {
-        //when you change order, recreate the window, forwardFFT, fifo, fftData
-        //also reset the fifoIndex
-        //things that need recreating should be created on the heap via std::make_unique<>
+        //each order's FFT and window come from the process-wide FFTPlans,
+        //built the first time any instance uses them, so switching back and
+        //forth afterwards is just a pointer swap.
+        //the scratch buffer and the frames only ever grow, so they stop
+        //allocating once the largest order has been used.
 
         order = newOrder;
         auto fftSize = getFFTSize();
 
-        forwardFFT = std::make_unique<juce::dsp::FFT>(order);
-        window = std::make_unique<juce::dsp::WindowingFunction<float>>(fftSize, juce::dsp::WindowingFunction<float>::blackmanHarris);
-
-        fftData.clear();
-        fftData.resize(fftSize * 2, 0);
+        plan = &sharedPlans->get(order);
 
-        fftDataFifo.prepare(fftData.size());
+        if (complexData.size() < (size_t)fftSize)
+            complexData.resize((size_t)fftSize);
     }
     //==============================================================================
     int getFFTSize() const { return 1 << order; }
     int getNumAvailableFFTDataBlocks() const { return fftDataFifo.getNumAvailableForReading(); }
+    size_t getNumBytes() const
+    {
+        // the FIFO slots and the complex scratch buffer (as big as the largest
+        // order used so far, and so are the slots); the plans aren't ours
+        return size_t(fftDataFifo.getCapacity()) * complexData.size() * sizeof(float)
+             + complexData.size() * sizeof(juce::dsp::Complex<float>);
+    }
     //==============================================================================
-    bool getFFTData(BlockType& fftData) { return fftDataFifo.pull(fftData); }
+    // Swaps the frame into fftData, which should be preallocated to getFFTSize()
+    bool getFFTData(BlockType& fftData) { return fftDataFifo.pullBySwapping(fftData); }
 private:
-    FFTOrder order;
-    BlockType fftData;
-    std::unique_ptr<juce::dsp::FFT> forwardFFT;
-    std::unique_ptr<juce::dsp::WindowingFunction<float>> window;
+    FFTOrder order = FFTOrder::order2048;
+    juce::SharedResourcePointer<FFTPlans> sharedPlans;
+    const FFTPlans::Plan* plan = nullptr;
+    std::vector<juce::dsp::Complex<float>> complexData;
 
-    Fifo<BlockType> fftDataFifo;
+    // PathProducer drains this after every FFT, so it never holds more than one frame
+    Fifo<BlockType> fftDataFifo{ 2 };
 };
 
 
 
 
+// How the analyzer traces move from frame to frame, and how much they're smoothed across frequency
+struct AnalyzerBallistics
+{
+    // Time constant of the exponential averaging, 0 for none
+    float averagingSeconds = 0.1f;
+
+    // Let peaks fall back at peakDecayDbPerSecond instead of following the average down
+    bool peakHold = false;
+    static constexpr float peakDecayDbPerSecond = 12.f;
+
+    // Width of the fractional-octave smoothing, e.g. 1/3 or 1/24, 0 for none
+    float smoothingOctaves = 0.f;
+};
+
+
 template<typename PathType>
 struct AnalyzerPathGenerator
 {
     /*
-     converts 'renderData[]' into a juce::Path
+     converts 'renderData[]' (fftSize / 2 bins) into a juce::Path
+
+     Every pixel column gets one point: the loudest of the bins that land in it.
+     Which bins those are only changes with the width, the FFT size or the
+     sample rate, so the mapping is worked out once and cached. Columns no bin
+     lands in (the sparse low end) are skipped and bridged by the line.
+
+     If 'lowBandData' is given, it's a spectrum of the same size with finer
+     bins (lowBandBinWidth) that is used for everything below crossoverFreq.
+
+     The column values then get the ballistics in a single pass: smoothing,
+     averaging and peak hold. frameSeconds is the time since the previous frame.
+     Smoothing works on the columns rather than the bins: x is already log
+     frequency, so a fixed fraction of an octave is a fixed number of pixels,
+     and the box average over it comes out of a running sum.
      */
-    void generatePath(const std::vector<float>& renderData,
+    void generatePath(const float* renderData,
         juce::Rectangle<float> fftBounds,
         int fftSize,
         float binWidth,
-        float negativeInfinity)
+        float negativeInfinity,
+        const AnalyzerBallistics& ballistics,
+        float frameSeconds,
+        const float* lowBandData = nullptr,
+        float lowBandBinWidth = 0.f,
+        float crossoverFreq = 0.f)
     {
         auto top = fftBounds.getY();
         auto bottom = fftBounds.getHeight();
-        auto width = fftBounds.getWidth();
+        auto width = (int)fftBounds.getWidth();
 
-        int numBins = (int)fftSize / 2;
+        if (lowBandData == nullptr)
+            lowBandBinWidth = crossoverFreq = 0.f;
+
+        if (width != mappedWidth || fftSize != mappedFFTSize || binWidth != mappedBinWidth
+            || lowBandBinWidth != mappedLowBandBinWidth || crossoverFreq != mappedCrossoverFreq)
+            updateColumns(width, fftSize, binWidth, lowBandBinWidth, crossoverFreq);
+
+        if (ballistics.smoothingOctaves != mappedSmoothingOctaves)
+            updateSmoothingRanges(ballistics.smoothingOctaves);
+
+        const auto numColumns = columns.size();
+
+        // The running sum for the smoothing: runningSum[c + 1] is the sum of columns [0, c]
+        for (size_t c = 0; c < numColumns; ++c)
+        {
+            const auto& column = columns[c];
+            auto* first = (column.isLowBand ? lowBandData : renderData) + column.firstBin;
+            columnValues[c] = *std::max_element(first, first + column.numBins);
+            runningSum[c + 1] = runningSum[c] + columnValues[c];
+        }
+
+        const auto smooth = ballistics.smoothingOctaves > 0.f;
+        const auto alpha = ballistics.averagingSeconds > 0.f && isPrimed
+                               ? 1.f - std::exp(-frameSeconds / ballistics.averagingSeconds)
+                               : 1.f;
+        const auto decay = ballistics.peakHold ? AnalyzerBallistics::peakDecayDbPerSecond * frameSeconds
+                                               : std::numeric_limits<float>::infinity();
+
+        for (size_t c = 0; c < numColumns; ++c)
+        {
+            auto v = columnValues[c];
+
+            if (smooth)
+            {
+                auto range = smoothingRanges[c];
+                v = (runningSum[(size_t)range.getEnd()] - runningSum[(size_t)range.getStart()]) / (float)range.getLength();
+            }
+
+            auto& average = averages[c];
+            average += alpha * (v - average);
+
+            // With peak hold off the decay is infinite, so this is just the average
+            held[c] = isPrimed ? juce::jmax(average, held[c] - decay) : average;
+        }
+
+        isPrimed = true;
 
-        PathType p;
-        p.preallocateSpace(3 * (int)fftBounds.getWidth());
+        // Build the path in its FIFO slot; clear() keeps the slot's storage around
+        auto* slot = pathFifo.beginWrite();
+        if (slot == nullptr)
+            return;
+
+        auto& p = *slot;
+        p.clear();
 
         auto map = [bottom, top, negativeInfinity](float v)
             {
@@ -135,26 +390,64 @@ struct AnalyzerPathGenerator
         if (std::isnan(y) || std::isinf(y))
             y = bottom;
 
-        p.startNewSubPath(0, y);
-
-        const int pathResolution = 2; //you can draw line-to's every 'pathResolution' pixels.
+        points.clear();
+        points.push_back({ 0.f, y });
 
-        for (int binNum = 1; binNum < numBins; binNum += pathResolution)
+        for (size_t c = 0; c < numColumns; ++c)
         {
-            y = map(renderData[binNum]);
+            y = map(held[c]);
 
             //            jassert( !std::isnan(y) && !std::isinf(y) );
 
             if (!std::isnan(y) && !std::isinf(y))
+                points.push_back({ (float)columns[c].x, y });
+        }
+
+        // Fewer segments to stroke on the message thread, none of them visibly off
+        auto numPoints = simplifyPolyline(points.data(), points.size(), pathSimplificationTolerance);
+
+        p.preallocateSpace(3 * (int)numPoints);
+        p.startNewSubPath(points[0]);
+
+        for (size_t i = 1; i < numPoints; ++i)
+            p.lineTo(points[i]);
+
+        pathFifo.finishWrite();
+    }
+
+    // Starts the averaging and peak hold over from the next frame
+    void resetBallistics() { isPrimed = false; }
+
+    // The last frame's levels (ballistics applied) for every pixel column across the
+    // width, for the spectrogram. Columns no bin landed in are interpolated from
+    // their neighbours, the same way the path's lines bridge them.
+    void getPixelLevels(std::vector<float>& dest, float negativeInfinity) const
+    {
+        dest.resize((size_t)juce::jmax(mappedWidth, 0));
+
+        if (columns.empty())
+        {
+            std::fill(dest.begin(), dest.end(), negativeInfinity);
+            return;
+        }
+
+        size_t c = 0;
+
+        for (int x = 0; x < (int)dest.size(); ++x)
+        {
+            while (c + 1 < columns.size() && columns[c + 1].x <= x)
+                ++c;
+
+            if (x <= columns[c].x || c + 1 == columns.size())
+            {
+                dest[(size_t)x] = held[c];
+            }
+            else
             {
-                auto binFreq = binNum * binWidth;
-                auto normalizedBinX = juce::mapFromLog10(binFreq, 20.f, 20000.f);
-                int binX = std::floor(normalizedBinX * width);
-                p.lineTo(binX, y);
+                auto t = float(x - columns[c].x) / float(columns[c + 1].x - columns[c].x);
+                dest[(size_t)x] = held[c] + t * (held[c + 1] - held[c]);
             }
         }
-
-        pathFifo.push(p);
     }
 
     int getNumPathsAvailable() const
@@ -162,12 +455,123 @@ struct AnalyzerPathGenerator
         return pathFifo.getNumAvailableForReading();
     }
 
+    // Swaps rather than copies, so 'path' gets the slot's old storage to reuse
     bool getPath(PathType& path)
     {
-        return pathFifo.pull(path);
+        return pathFifo.pullBySwapping(path);
     }
 private:
-    Fifo<PathType> pathFifo;
+    // Drained right after every path is generated, like the FFT data FIFO
+    Fifo<PathType> pathFifo{ 2 };
+
+    // The run of bins that lands in pixel column x
+    struct Column
+    {
+        int x, firstBin, numBins;
+        bool isLowBand;
+    };
+
+    std::vector<Column> columns;
+    int mappedWidth = -1, mappedFFTSize = -1;
+    float mappedBinWidth = -1.f, mappedLowBandBinWidth = -1.f, mappedCrossoverFreq = -1.f;
+
+    void updateColumns(int width, int fftSize, float binWidth, float lowBandBinWidth, float crossoverFreq)
+    {
+        mappedWidth = width;
+        mappedFFTSize = fftSize;
+        mappedBinWidth = binWidth;
+        mappedLowBandBinWidth = lowBandBinWidth;
+        mappedCrossoverFreq = crossoverFreq;
+
+        columns.clear();
+        columns.reserve((size_t)juce::jmax(width, 0));
+
+        int numBins = (int)fftSize / 2;
+
+        // The bins' x positions only ever increase, so each column is one contiguous run
+        auto addBins = [this, width, numBins](float bandBinWidth, float minFreq, float maxFreq, bool isLowBand)
+            {
+                for (int binNum = 1; binNum < numBins; ++binNum)
+                {
+                    auto binFreq = binNum * bandBinWidth;
+
+                    if (binFreq < minFreq)
+                        continue;
+
+                    if (binFreq >= maxFreq)
+                        break;
+
+                    auto normalizedBinX = juce::mapFromLog10(binFreq, 20.f, 20000.f);
+                    int binX = (int)std::floor(normalizedBinX * (float)width);
+
+                    if (binX < 0)
+                        continue;
+
+                    if (binX >= width)
+                        break;
+
+                    if (!columns.empty() && columns.back().x == binX && columns.back().isLowBand == isLowBand)
+                        ++columns.back().numBins;
+                    else
+                        columns.push_back({ binX, binNum, 1, isLowBand });
+                }
+            };
+
+        if (lowBandBinWidth > 0.f)
+            addBins(lowBandBinWidth, 0.f, crossoverFreq, true);
+
+        addBins(binWidth, crossoverFreq, std::numeric_limits<float>::max(), false);
+
+        columnValues.resize(columns.size());
+        points.reserve(columns.size() + 1);
+        averages.resize(columns.size());
+        held.resize(columns.size());
+        runningSum.assign(columns.size() + 1, 0.f);
+
+        // The columns moved, so neither the ranges nor the history mean anything any more
+        updateSmoothingRanges(mappedSmoothingOctaves);
+        isPrimed = false;
+    }
+
+    // The per-column values, and the state the ballistics carry between frames
+    std::vector<float> columnValues, averages, held, runningSum;
+    bool isPrimed = false;
+
+    // The trace before it's simplified and turned into a path
+    std::vector<juce::Point<float>> points;
+
+    // For each column, the run of columns within half the smoothing width either side of it
+    std::vector<juce::Range<int>> smoothingRanges;
+    float mappedSmoothingOctaves = 0.f;
+
+    void updateSmoothingRanges(float smoothingOctaves)
+    {
+        mappedSmoothingOctaves = smoothingOctaves;
+        smoothingRanges.resize(columns.size());
+
+        if (mappedWidth <= 0)
+            return;
+
+        // The display spans 20 Hz to 20 kHz, log2(1000) octaves across the width
+        const auto pixelsPerOctave = (float)mappedWidth / std::log2(1000.f);
+        const auto halfWidth = 0.5f * smoothingOctaves * pixelsPerOctave;
+
+        size_t start = 0, end = 0;
+
+        for (size_t c = 0; c < columns.size(); ++c)
+        {
+            auto x = (float)columns[c].x;
+
+            while ((float)columns[start].x < x - halfWidth)
+                ++start;
+
+            end = juce::jmax(end, c + 1);
+            while (end < columns.size() && (float)columns[end].x <= x + halfWidth)
+                ++end;
+
+            smoothingRanges[c] = { (int)start, (int)end };
+        }
+    }
 };
 
 
@@ -176,6 +580,8 @@ private:
 
 
 //==============================================================================1
+// One instance is shared by every slider and button of an editor, so whatever
+// it caches is only drawn once per editor however many controls use it.
 struct LookAndFeel : juce::LookAndFeel_V4
 {
     void drawRotarySlider(juce::Graphics&,
@@ -189,6 +595,25 @@ struct LookAndFeel : juce::LookAndFeel_V4
                           juce::ToggleButton& toggleButton, 
                           bool shouldDrawButtonAsHighlighted, 
                           bool shouldDrawButtonAsDown) override;
+
+private:
+    // The part of a knob that doesn't move, per diameter and pixel scale
+    struct KnobFace
+    {
+        int diameter;
+        float scale;
+        juce::Image image;
+    };
+
+    std::vector<KnobFace> knobFaces;
+    const juce::Image& getKnobFace(int diameter, float scale);
+
+    // The power buttons are all the same size, so the glyph is built once for it
+    juce::Path powerGlyph;
+    juce::Rectangle<int> powerGlyphBounds;
+
+    // A made up spectrum across the unit square, the same one every time
+    static const juce::Path& getAnalyzerGlyph();
 };
 
 
@@ -200,29 +625,28 @@ struct RotarySliderWithLabels : juce::Slider
         param(&rap),
         suffix(unitSuffix)
     {
-        setLookAndFeel(&lnf);
     }
 
-    ~RotarySliderWithLabels()
-    {
-		setLookAndFeel(nullptr);
-	}
-
     struct LabelPos
     {
 		float pos;
 		juce::String label;
 	};
 
+    // Set these up before the slider is first painted, they're cached from then on
     juce::Array<LabelPos> labels;
 
     void paint(juce::Graphics& g) override;
+    void resized() override;
     juce::Rectangle<int> getSliderBounds() const;
     int getTextHeight() const { return 14; }
     juce::String getDisplayString() const;
 
 private:
-    LookAndFeel lnf;
+    // The range labels around the knob, drawn once per size and pixel scale
+    juce::Image labelsLayer;
+    float labelsLayerScale = 0.f;
+    void drawLabels(juce::Graphics& g);
 
     juce::RangedAudioParameter* param;
     juce::String suffix;
@@ -231,35 +655,263 @@ private:
 
 //==============================================================================
 
+// What the two analyzer traces show
+enum class AnalyzerView
+{
+    LeftRight,
+    MidSide,
+    Sum
+};
+
+// A scrolling spectrogram, newest frame at the top. The image is used as a ring
+// of rows: a new frame only overwrites the oldest row, and draw() puts the two
+// halves either side of the write position on screen with one blit each.
+// x is the same log frequency axis as the traces; each row is a fixed slice of
+// time, see PathProducer::spectrogramRowsPerSecond.
+struct Spectrogram
+{
+    // Clears the history
+    void setSize(int width, int height);
+
+    // One frame, already coloured with levelToPixel(); ignored if it's the wrong width
+    void addRow(const juce::uint32* pixels, int numPixels);
+
+    void draw(juce::Graphics& g, juce::Rectangle<int> area) const;
+
+    void clear();
+
+    // Maps a level between negativeInfinity and 0 dB through a lookup table to a
+    // premultiplied pixel in the image's native layout. Quiet levels are mostly
+    // transparent, so the grid still shows through.
+    static juce::uint32 levelToPixel(float decibels, float negativeInfinity)
+    {
+        const auto& colourMap = getColourMap();
+        auto index = (int)((decibels - negativeInfinity) * (float(colourMap.size() - 1) / -negativeInfinity));
+        return colourMap[(size_t)juce::jlimit(0, (int)colourMap.size() - 1, index)];
+    }
+
+private:
+    juce::Image image;
+
+    // The row the newest frame went into
+    int newestRow = 0;
+
+    static const std::array<juce::uint32, 256>& getColourMap();
+};
+
+
+// Analyses both channels of the analyzer feed with one FFT per window
+// and turns the result into a path per trace.
+// process() runs on an analysis worker, one call at a time; everything else
+// is for the message thread.
 struct PathProducer
 {
-    PathProducer(SingleChannelSampleFifo<SimpleQAudioProcessor::BlockType>& scsf) :
-		leftChannelFifo(&scsf)
+    PathProducer(SampleRing& leftRing, SampleRing& rightRing) :
+		leftChannelRing(&leftRing),
+		rightChannelRing(&rightRing)
 	{
-		leftChannelFFTDataGenerator.changeOrder(FFTOrder::order2048);
-        monoBuffer.setSize(1, leftChannelFFTDataGenerator.getFFTSize());
+        // Nothing is allocated until the first frame, see prepareAnalysis()
 	}
     void process(juce::Rectangle<float> fftBounds, double sampleRate);
-    juce::Path getPath() { return leftChannelFFTPath; }
 
+    // Takes the paths process() has finished since the last call, returns true if there were any
+    bool pullPaths();
+
+    // Trace 0 is left, mid or the sum; trace 1 is right or side, and is empty for the sum
+    const juce::Path& getPath(int trace) const { return paths[(size_t)trace]; }
+    size_t getNumBytes() const;
+
+    // How much consecutive analysis windows share, from 0.5 up to 0.875.
+    // The hop between windows is fftSize * (1 - overlap), whatever the host block size.
+    void setOverlap(float newOverlap);
+    float getOverlap() const { return overlap; }
+    int getHopSize() const;
+
+    void setView(AnalyzerView newView);
+    AnalyzerView getView() const { return view; }
+
+    // The resolution asked for; getCurrentOrder() can be lower while stepped down
+    void setOrder(FFTOrder newOrder) { requestedOrder = newOrder; }
+    FFTOrder getOrder() const { return requestedOrder; }
+    FFTOrder getCurrentOrder() const { return currentOrder; }
+
+    // When enabled, the order is stepped down while analysing a frame takes longer
+    // than analysisBudgetMs, and back up towards getOrder() once there's room again
+    void setAutoStepDown(bool shouldStepDown) { autoStepDown = shouldStepDown; }
+    bool isAutoStepDownEnabled() const { return autoStepDown; }
+
+    static constexpr double analysisBudgetMs = 1.0;
+
+    // Multi-resolution analysis: below getCrossoverFrequency() the traces come from
+    // a second FFT of the same size, run on the signal decimated by lowBandDecimation.
+    // Its bins are lowBandDecimation times finer, so a 2048 point pair of FFTs
+    // resolves the low end better than a single 8192 point one, at about half the cost.
+    void setMultiResolution(bool shouldUseMultiResolution) { multiResolution = shouldUseMultiResolution; }
+    bool isMultiResolutionEnabled() const { return multiResolution; }
+
+    static constexpr int lowBandDecimation = 8;
+    static float getCrossoverFrequency(double sampleRate) { return float(sampleRate / (4 * lowBandDecimation)); }
+
+    void setBallistics(const AnalyzerBallistics& newBallistics);
+    AnalyzerBallistics getBallistics() const;
+
+    // While enabled, trace 0 (left, mid or the sum) is also turned into spectrogram
+    // rows, and trace 1 isn't analysed at all. Rows are spectrogramRowsPerSecond of
+    // audio apart, counted from the write position, so the scroll speed doesn't depend
+    // on the hop size or the display rate: the newest frame is repeated when windows
+    // come slower than rows, and only the newest of several is used when they come faster.
+    void setSpectrogram(bool shouldProduceSpectrogram) { spectrogram = shouldProduceSpectrogram; }
+    bool isSpectrogramEnabled() const { return spectrogram; }
+
+    static constexpr double spectrogramRowsPerSecond = 50.0;
+
+    // Adds the rows process() has finished since the last call, returns true if there were any
+    bool pullSpectrogramRows(Spectrogram& destination);
 
 private:
-    SingleChannelSampleFifo<SimpleQAudioProcessor::BlockType>* leftChannelFifo;
+    SampleRing* leftChannelRing;
+    SampleRing* rightChannelRing;
+
+    // Set from the message thread, applied by process()
+    std::atomic<float> overlap{ 0.75f };
+    std::atomic<AnalyzerView> view{ AnalyzerView::LeftRight };
+    std::atomic<FFTOrder> requestedOrder{ FFTOrder::order2048 }, currentOrder{ FFTOrder::order2048 };
+    std::atomic<bool> autoStepDown{ false };
+    std::atomic<bool> multiResolution{ true };
+    std::atomic<float> averagingSeconds{ AnalyzerBallistics().averagingSeconds };
+    std::atomic<bool> peakHold{ AnalyzerBallistics().peakHold };
+    std::atomic<float> smoothingOctaves{ AnalyzerBallistics().smoothingOctaves };
+    std::atomic<bool> spectrogram{ false };
+
+    // What process() last applied
+    FFTOrder appliedRequestedOrder = FFTOrder::order2048;
+    AnalyzerView appliedView = AnalyzerView::LeftRight;
+    bool appliedSpectrogram = false;
+
+    // Smoothed time spent analysing a frame, or negative until the first one at this order
+    double averageAnalysisMs = -1.0;
+
+    // Done by the first process() call rather than the constructor, so opening
+    // the editor doesn't wait for it: the first job is queued after the first paint
+    bool isAnalysisPrepared = false;
+    void prepareAnalysis();
+
+    void applyOrder(FFTOrder newOrder);
+    void updateAutoStepDown(double analysisMs);
+
+    // Where the last analysed window ended, in samples since the rings were last reset
+    juce::int64 lastWindowEnd = -1;
+    juce::uint32 ringGeneration = 0;
+
+    // The analysis window of each channel, read out of the rings
+    juce::AudioBuffer<float> analysisBuffer;
+
+    FFTDataGenerator<std::vector<float>> fftDataGenerator;
+
+    // The frame being turned into paths; swapped with the FIFO slots, never copied
+    std::vector<float> fftData;
+
+    // Filled by process(), drained by pullPaths()
+    std::array<AnalyzerPathGenerator<juce::Path>, 2> pathGenerators;
+
+    std::array<juce::Path, 2> paths;
+
+    // Rows are copied into their FIFO slots and swapped out, like the paths.
+    // spectrogramPixels is the newest frame, coloured; lastSpectrogramRow counts
+    // rows since the rings were last reset, or is negative until the first one.
+    Fifo<std::vector<juce::uint32>> spectrogramRows{ 16 };
+    std::vector<float> spectrogramLevels;
+    std::vector<juce::uint32> spectrogramPixels;
+    std::vector<juce::uint32> spectrogramRow;
+    juce::int64 lastSpectrogramRow = -1;
+    void pushSpectrogramRows(juce::int64 writePosition, double sampleRate);
+
+    // The decimated history of each channel for the low band. It's kept up to date
+    // by running every new sample through the anti-aliasing filters, which costs
+    // far less than the extra FFT.
+    std::array<SampleRing, 2> lowBandRings;
+    std::array<std::array<juce::dsp::IIR::Filter<float>, 4>, 2> lowBandFilters;
+    double lowBandSampleRate = 0.0;
+    juce::int64 lastDecimatedPosition = -1;
+    int decimationPhase = 0;
+    std::vector<float> decimatedScratch;
+
+    // The low band's analysis window and spectrum
+    juce::AudioBuffer<float> lowBandBuffer;
+    std::vector<float> lowBandFFTData;
+
+    void updateLowBand(juce::int64 writePosition, double sampleRate);
+    void resetLowBandFilters();
+};
 
-    juce::AudioBuffer<float> monoBuffer;
 
-    FFTDataGenerator<std::vector<float>> leftChannelFFTDataGenerator;
+// One process-wide pool runs the analysis for every open editor. Each editor
+// queues a job per frame and whichever worker is free takes the next one,
+// whichever instance it belongs to, so a busy instance can't hold up the
+// others and the message thread only picks up finished paths.
+struct AnalysisWorkerPool
+{
+    AnalysisWorkerPool() :
+        pool(juce::jlimit(1, 4, juce::SystemStats::getNumCpus() / 2))
+    {
+    }
 
-    AnalyzerPathGenerator<juce::Path> pathProducer;
+    juce::ThreadPool pool;
+};
+
+
+// A frame's analysis for one PathProducer
+struct AnalysisJob : juce::ThreadPoolJob
+{
+    AnalysisJob(PathProducer& producerToRun) :
+        juce::ThreadPoolJob("SimpleQ Analysis"),
+        producer(producerToRun)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        producer.process(fftBounds, sampleRate);
+        return jobHasFinished;
+    }
+
+    PathProducer& producer;
 
-    juce::Path leftChannelFFTPath;
+    // Only written while the job isn't queued
+    juce::Rectangle<float> fftBounds;
+    double sampleRate = 0.0;
 };
 
 
 
+// Evaluates the magnitude response of a whole CoefficientSnapshot at a fixed set
+// of frequencies, one per pixel column.
+// For a biquad with real coefficients and phi = sin^2(w / 2),
+//   |B(e^jw)|^2 = (b0 + b1 + b2)^2 - 4 (b0 b1 + b1 b2 + 4 b0 b2) phi + 16 b0 b2 phi^2
+// and likewise for A with a0 = 1. So once phi is known per column, each stage
+// is two quadratics per column, with none of the cancellation the cos(w) form
+// suffers from near DC. The stages are summed as log2 power ratios, which
+// doesn't underflow however steep the cuts are.
+struct ResponseCurveEvaluator
+{
+    // Only needed when the width or the sample rate changes; returns true if anything did
+    bool prepare(int numColumns, double sampleRate);
+
+    int getNumColumns() const { return (int)phis.size(); }
+
+    // Writes the response of the active stages in [firstStage, firstStage + numStages)
+    // in decibels to decibels[0, getNumColumns()). Responses of separate runs of
+    // stages can simply be added up.
+    void evaluate(const CoefficientSnapshot& snapshot, int firstStage, int numStages, float* decibels) const;
+
+private:
+    std::vector<float> phis;
+    double preparedSampleRate = 0.0;
+};
+
+
 struct ResponseCurveComponent : juce::Component,
-    juce::AudioProcessorParameter::Listener,
-    juce::Timer
+    juce::AudioProcessorParameter::Listener
 {
 	ResponseCurveComponent(SimpleQAudioProcessor&);
 	~ResponseCurveComponent();
@@ -268,26 +920,74 @@ struct ResponseCurveComponent : juce::Component,
 
 	void parameterGestureChanged(int parameterIndex, bool gestureIsStarting) override { }
 
-	void timerCallback() override;
-
     void paint(juce::Graphics& g) override;
 
     void resized() override;
 
-    void toggleAnalysisEnablement(bool enabled){ shouldShowFFTAnalysis = enabled;}
+    // Right-click picks what the analyzer traces show and its resolution
+    void mouseDown(const juce::MouseEvent& e) override;
+
+    // Also (un)subscribes us from the processor's analyzer feed
+    void toggleAnalysisEnablement(bool enabled);
 
 
+    juce::String getAnalyzerMemoryReport() const;
+
 private:
     SimpleQAudioProcessor& audioProcessor;
+
+    // Held for as long as this component exists, see SimpleQAudioProcessor::acquireAnalyzerFeed()
+    SimpleQAudioProcessor::AnalyzerFeed& analyzerFeed;
+
     juce::Atomic<bool> parametersChanged{ false };
 
-    MonoChain monoChain;
+    // What the curve is drawn from: the coefficients the processor published,
+    // see SimpleQAudioProcessor::getPublishedCoefficients()
+    CoefficientSnapshot snapshot;
+    juce::uint32 snapshotVersion = 0;
+
+    // When the parameters last moved without the processor publishing anything since
+    bool hasUnpublishedChange = true;
+    juce::uint32 unpublishedChangeTimeMs = 0;
+
+    // How long to wait for the processor before designing the coefficients here,
+    // for when the host isn't calling processBlock (stopped transport, suspended plugin)
+    static constexpr juce::uint32 publishTimeoutMs = 250;
+
+    // Returns true if there's a new snapshot to draw
+    bool updateSnapshot();
 
     void updateResponseCurve();
 
     juce::Path responseCurve;
+    std::vector<juce::Point<float>> responseCurvePoints;
+
+    ResponseCurveEvaluator responseCurveEvaluator;
+    std::vector<float> responseCurveDecibels;
+
+    // Each band's curve is kept on its own, so a new snapshot only gets the
+    // bands whose stages actually changed evaluated again
+    enum Band
+    {
+        LowCutBand,
+        PeakBand,
+        HighCutBand,
+        NumBands
+    };
+
+    struct BandCurve
+    {
+        std::vector<float> decibels;
+        bool isDirty = true;
+    };
+
+    std::array<BandCurve, NumBands> bandCurves;
 
-    void updateChain();
+    // What's under and over the curves, see renderLayers()
+    juce::Image backgroundLayer, foregroundLayer;
+    float layerScale = 0.f;
+
+    void renderLayers(float scale);
 
     void drawBackgroundGrid(juce::Graphics& g);
 
@@ -301,9 +1001,60 @@ private:
 
     juce::Rectangle<int> getAnalysisArea();
 
-    PathProducer leftPathProducer, rightPathProducer;
+    PathProducer pathProducer;
+
+    juce::SharedResourcePointer<AnalysisWorkerPool> analysisWorkers;
+    AnalysisJob analysisJob{ pathProducer };
+
+    bool shouldShowFFTAnalysis = false;
+
+    // Drawn instead of the traces while the analyzer's in spectrogram mode
+    Spectrogram spectrogram;
+    void setSpectrogramEnabled(bool enabled);
 
-    bool shouldShowFFTAnalysis = true;
+    // Paced by the display rather than a timer, and only called while we're on screen
+    void onVBlank();
+    juce::VBlankAttachment vBlankAttachment{ this, [this] { onVBlank(); } };
+};
+
+
+//==============================================================================
+
+// Lists the shared preset library straight out of its mapped index.
+// Typing filters by name, words starting with '#' filter by tag, and
+// the Save button stores the current settings under the typed name and tags.
+struct PresetBrowser : juce::Component,
+    juce::ListBoxModel,
+    juce::ChangeListener
+{
+    PresetBrowser(SimpleQAudioProcessor&);
+    ~PresetBrowser() override;
+
+    // The shared library was saved to, maybe by another editor, so our indices are stale
+    void changeListenerCallback(juce::ChangeBroadcaster*) override { refresh(); }
+
+    void refresh();
+
+    int getNumRows() override { return matches.size(); }
+    void paintListBoxItem(int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected) override;
+    void listBoxItemClicked(int row, const juce::MouseEvent&) override;
+
+    void paint(juce::Graphics& g) override;
+    void resized() override;
+
+private:
+    SimpleQAudioProcessor& audioProcessor;
+    juce::SharedResourcePointer<PresetLibrary> library;
+
+    juce::TextEditor searchBox;
+    juce::TextButton saveButton{ "Save" };
+    juce::ListBox list;
+
+    juce::Array<int> matches;
+
+    // Splits the search box text into the name part and the '#tags'
+    void parseQuery(juce::String& name, juce::StringArray& tags) const;
+    void saveCurrentSettings();
 };
 
 
@@ -315,7 +1066,8 @@ struct AnalyzerButton : juce::ToggleButton {};
 
 /**
 */
-class SimpleQAudioProcessorEditor  : public juce::AudioProcessorEditor 
+class SimpleQAudioProcessorEditor  : public juce::AudioProcessorEditor,
+                                      private juce::ChangeListener
 {
 public:
     SimpleQAudioProcessorEditor (SimpleQAudioProcessor&);
@@ -331,6 +1083,15 @@ private:
     // access the processor object that created it.
     SimpleQAudioProcessor& audioProcessor;
 
+   #if SIMPLEQ_ENABLE_PROFILING
+    // When construction started, for the open time report
+    const double openStartMs = juce::Time::getMillisecondCounterHiRes();
+    bool hasReportedOpenTime = false;
+   #endif
+
+    // Declared before the controls that use it, so it outlives them
+    LookAndFeel lnf;
+
     RotarySliderWithLabels peakFreqSlider,
                            peakGainSlider,
                            peakQualitySlider,
@@ -362,11 +1123,24 @@ private:
                      peakBypassButtonAttachment, 
                      analyzerEnabledButtonAttachment;
 
+    // Programs and A/B compare live in the top bar, next to the analyzer button
+    juce::ComboBox programBox;
+    juce::TextButton abSlotAButton{ "A" }, abSlotBButton{ "B" };
+    juce::Slider morphTimeSlider{ juce::Slider::SliderStyle::LinearBar,
+                                  juce::Slider::TextEntryBoxPosition::TextBoxLeft };
+    Attachment morphTimeSliderAttachment;
 
+    juce::TextButton libraryButton{ "Library" };
+    PresetBrowser presetBrowser;
 
-    std::vector<juce::Component*> getComps();
+    void updateABButtons();
 
-    LookAndFeel lnf;
+    // The program or A/B slot changed, maybe from the host
+    void changeListenerCallback(juce::ChangeBroadcaster* source) override;
+
+
+
+    std::vector<juce::Component*> getComps();
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SimpleQAudioProcessorEditor)
 };
@@ -22,6 +22,7 @@ SimpleQAudioProcessor::SimpleQAudioProcessor()
                        )
 #endif
 {
+    createFactoryPrograms();
 }
 
 SimpleQAudioProcessor::~SimpleQAudioProcessor()
@@ -68,26 +69,234 @@ double SimpleQAudioProcessor::getTailLengthSeconds() const
 
 int SimpleQAudioProcessor::getNumPrograms()
 {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
+    return (int)programs.size();
 }
 
 int SimpleQAudioProcessor::getCurrentProgram()
 {
-    return 0;
+    return currentProgram;
 }
 
 void SimpleQAudioProcessor::setCurrentProgram (int index)
 {
+    if (!juce::isPositiveAndBelow(index, getNumPrograms()))
+        return;
+
+    // Reported straight away, loaded on the message thread
+    currentProgram = index;
+    pendingProgram = index;
+
+    if (juce::MessageManager::existsAndIsCurrentThread())
+        handleUpdateNowIfNeeded();
+    else
+        triggerAsyncUpdate();
+}
+
+
+void SimpleQAudioProcessor::handleAsyncUpdate()
+{
+    auto index = pendingProgram.exchange(-1);
+
+    if (!juce::isPositiveAndBelow(index, getNumPrograms()))
+        return;
+
+    morphTo(programs[(size_t)index].snapshot);
+
+    updateHostDisplay(juce::AudioProcessor::ChangeDetails().withProgramChanged(true));
+    sendChangeMessage();
 }
 
 const juce::String SimpleQAudioProcessor::getProgramName (int index)
 {
-    return {};
+    if (!juce::isPositiveAndBelow(index, getNumPrograms()))
+        return {};
+
+    return programs[(size_t)index].name;
 }
 
 void SimpleQAudioProcessor::changeProgramName (int index, const juce::String& newName)
 {
+    if (juce::isPositiveAndBelow(index, getNumPrograms()))
+        programs[(size_t)index].name = newName;
+}
+
+
+void SimpleQAudioProcessor::createFactoryPrograms()
+{
+    auto makeSettings = [](float lowCutFreq, Slope lowCutSlope,
+                           float peakFreq, float peakGain, float peakQuality,
+                           float highCutFreq, Slope highCutSlope)
+        {
+            ChainSettings settings;
+            settings.lowCutFreq = lowCutFreq;
+            settings.lowCutSlope = lowCutSlope;
+            settings.peakFreq = peakFreq;
+            settings.peakGainInDecibels = peakGain;
+            settings.peakQuality = peakQuality;
+            settings.highCutFreq = highCutFreq;
+            settings.highCutSlope = highCutSlope;
+            return settings;
+        };
+
+    auto addProgram = [this](const juce::String& name, const ChainSettings& settings)
+        {
+            // Snapped to the parameter ranges, so that the values read back after
+            // loading the program match the ones its snapshot was designed with
+            Program program;
+            program.name = name;
+            program.snapshot.settings = snapToParameterGrid(settings);
+            programs.push_back(program);
+        };
+
+    addProgram("Init",            makeSettings(20.f,  Slope_12, 750.f,   0.f,  1.f,  20000.f, Slope_12));
+    addProgram("Rumble Filter",   makeSettings(80.f,  Slope_24, 750.f,   0.f,  1.f,  20000.f, Slope_12));
+    addProgram("Mud Cut",         makeSettings(40.f,  Slope_24, 300.f,  -5.f,  1.2f, 20000.f, Slope_12));
+    addProgram("Vocal Presence",  makeSettings(100.f, Slope_24, 3000.f,  4.f,  0.8f, 18000.f, Slope_12));
+    addProgram("Air Lift",        makeSettings(30.f,  Slope_12, 12000.f, 5.f,  0.5f, 20000.f, Slope_12));
+    addProgram("Telephone",       makeSettings(300.f, Slope_48, 1500.f,  6.f,  1.5f, 3400.f,  Slope_48));
+    addProgram("Lo-Fi",           makeSettings(200.f, Slope_36, 1000.f,  3.f,  0.7f, 5000.f,  Slope_36));
+}
+
+
+ChainSettings SimpleQAudioProcessor::snapToParameterGrid(const ChainSettings& settings) const
+{
+    // Round trips each value through its parameter the same way setValueNotifyingHost() does
+    auto snap = [this](const juce::String& parameterID, float value)
+        {
+            auto* param = apvts.getParameter(parameterID);
+            return param->convertFrom0to1(param->convertTo0to1(value));
+        };
+
+    auto snapped = settings;
+
+    snapped.lowCutFreq = snap("LowCut Freq", settings.lowCutFreq);
+    snapped.highCutFreq = snap("HighCut Freq", settings.highCutFreq);
+    snapped.peakFreq = snap("Peak Freq", settings.peakFreq);
+    snapped.peakGainInDecibels = snap("Peak Gain", settings.peakGainInDecibels);
+    snapped.peakQuality = snap("Peak Quality", settings.peakQuality);
+
+    return snapped;
+}
+
+
+void SimpleQAudioProcessor::setParameters(const ChainSettings& settings)
+{
+    auto set = [this](const juce::String& parameterID, float value)
+        {
+            auto* param = apvts.getParameter(parameterID);
+            param->beginChangeGesture();
+            param->setValueNotifyingHost(param->convertTo0to1(value));
+            param->endChangeGesture();
+        };
+
+    set("LowCut Freq", settings.lowCutFreq);
+    set("HighCut Freq", settings.highCutFreq);
+    set("Peak Freq", settings.peakFreq);
+    set("Peak Gain", settings.peakGainInDecibels);
+    set("Peak Quality", settings.peakQuality);
+    set("LowCut Slope", (float)settings.lowCutSlope);
+    set("HighCut Slope", (float)settings.highCutSlope);
+
+    set("LowCut Bypassed", settings.lowCutBypassed ? 1.f : 0.f);
+    set("Peak Bypassed", settings.peakBypassed ? 1.f : 0.f);
+    set("HighCut Bypassed", settings.highCutBypassed ? 1.f : 0.f);
+}
+
+
+int SimpleQAudioProcessor::getMorphLengthInSamples() const
+{
+    auto morphTimeMs = apvts.getRawParameterValue("Morph Time")->load();
+    return juce::roundToInt(morphTimeMs * 0.001 * getSampleRate());
+}
+
+
+void SimpleQAudioProcessor::morphTo(const ChainSettings& settings)
+{
+    CoefficientSnapshot snapshot;
+    snapshot.settings = settings;
+    morphTo(snapshot);
+}
+
+
+void SimpleQAudioProcessor::morphTo(const CoefficientSnapshot& snapshot)
+{
+    // The change is queued before any parameter moves, so the morph owns the
+    // whole transition; in between the audio thread holds what it's running
+    auto seq = parameterWriteSequence.load(std::memory_order_relaxed);
+    parameterWriteSequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto target = snapshot;
+    target.settings = snapToParameterGrid(snapshot.settings);
+
+    // Stages designed for other settings than the snapped ones get designed again
+    if (target.settings != snapshot.settings)
+        target.sampleRate = 0.0;
+
+    queueSnapshot(target, getMorphLengthInSamples());
+    setParameters(target.settings);
+
+    parameterWriteSequence.store(seq + 2, std::memory_order_release);
+}
+
+
+ChainSettings SimpleQAudioProcessor::readChainSettings(juce::uint32 before)
+{
+    if ((before & 1) != 0)
+        return lastChainSettings;
+
+    auto settings = getChainSettings(apvts);
+
+    // morphTo() started (or even finished) while we were reading, so some of
+    // these may be the old values and some the new ones
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (parameterWriteSequence.load(std::memory_order_relaxed) != before)
+        return lastChainSettings;
+
+    return settings;
+}
+
+
+void SimpleQAudioProcessor::queueSnapshot(const CoefficientSnapshot& snapshot, int morphLengthInSamples)
+{
+    auto sampleRate = getSampleRate();
+
+    // Not prepared yet, prepareToPlay() will design whatever the parameters hold by then
+    if (sampleRate <= 0.0)
+        return;
+
+    // The audio thread only ever copies the snapshot, so if it wasn't designed
+    // for this sample rate it gets (re)designed here. The settings are already
+    // snapped, i.e. exactly what the parameters will read back once set.
+    ProgramChange change;
+    change.snapshot = snapshot;
+    change.morphLengthInSamples = morphLengthInSamples;
+
+    if (snapshot.sampleRate != sampleRate)
+        change.snapshot = makeCoefficientSnapshot(snapshot.settings, sampleRate);
+
+    auto ok = programChanges.push(change);
+    juce::ignoreUnused(ok);
+}
+
+
+void SimpleQAudioProcessor::switchToABSlot(ABSlot slot)
+{
+    if (!abSlotsInitialised)
+    {
+        abSlots[SlotA] = abSlots[SlotB] = getChainSettings(apvts);
+        abSlotsInitialised = true;
+    }
+
+    if (slot == currentABSlot)
+        return;
+
+    abSlots[currentABSlot] = getChainSettings(apvts);
+    currentABSlot = slot;
+
+    morphTo(abSlots[slot]);
+    sendChangeMessage();
 }
 
 //==============================================================================
@@ -104,14 +313,30 @@ void SimpleQAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBloc
 
     spec.sampleRate = sampleRate;
 
+    // Every stage needs 2nd order coefficients before the chains size their state,
+    // so that snapshots can be copied in on the audio thread without allocating
+    prepareStagesForSnapshots(leftChain);
+    prepareStagesForSnapshots(rightChain);
+
     leftChain.prepare(spec);
     rightChain.prepare(spec);
 
-    updateFilters();
+    lastChainSettings = getChainSettings(apvts);
+    updateFilters(lastChainSettings);
+
+    morph = ChainMorph();
+
+    for (auto& program : programs)
+        program.snapshot = makeCoefficientSnapshot(program.snapshot.settings, sampleRate);
 
 
-    leftChannelFifo.prepare(samplesPerBlock);
-    rightChannelFifo.prepare(samplesPerBlock);
+    // The feed may be live, with a worker reading it, so it's never reallocated here;
+    // it was sized for analyzerMaxSampleRate. The stream starts over, though.
+    if (analyzerFeed != nullptr)
+    {
+        analyzerFeed->leftChannel.reset();
+        analyzerFeed->rightChannel.reset();
+    }
 
     //osc.initialise([](float x) {return std::sin(x); });
 
@@ -168,8 +393,6 @@ void SimpleQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce
         buffer.clear (i, 0, buffer.getNumSamples());
 
 
-    updateFilters();
-
     // Prepare to get each channel's block of data
     juce::dsp::AudioBlock<float> block(buffer);
 
@@ -179,6 +402,150 @@ void SimpleQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce
     //juce::dsp::ProcessContextReplacing<float> stereoContext(block);
     //osc.process(stereoContext);
 
+    // Taken before looking at the queue: a morphTo() that finished before this
+    // pushed its change first, so it's picked up below rather than its parameters
+    // being designed straight away without a morph
+    auto parameterSequence = parameterWriteSequence.load(std::memory_order_acquire);
+
+    handleProgramChanges();
+
+    // While morphTo() is halfway through setting the parameters, they describe
+    // neither the old settings nor the new ones, so stay where we are
+    auto chainSettings = readChainSettings(parameterSequence);
+
+    if (morph.isActive())
+    {
+        processMorphBlock(block);
+    }
+    else if (isNonRealtime())
+    {
+        processRenderBlock(block, chainSettings);
+    }
+    else
+    {
+        if (chainSettings != lastChainSettings)
+        {
+            updateFilters(chainSettings);
+            lastChainSettings = chainSettings;
+        }
+
+        processChains(block);
+    }
+
+    if (coefficientsChanged)
+        publishCoefficients();
+
+    // Nobody is watching the analyzer during a bounce, so don't feed it
+    if (isNonRealtime())
+        return;
+
+    pushIntoAnalyzerFeed(buffer);
+
+}
+
+
+void SimpleQAudioProcessor::publishCoefficients()
+{
+    auto snapshot = captureSnapshot(leftChain);
+    snapshot.settings = lastChainSettings;
+    snapshot.sampleRate = getSampleRate();
+
+    publishedCoefficients.publish(snapshot);
+    coefficientsChanged = false;
+}
+
+
+void SimpleQAudioProcessor::pushIntoAnalyzerFeed(const juce::AudioBuffer<float>& buffer)
+{
+    if (!hasAnalyzerSubscribers() || analyzerFeed == nullptr || !analyzerFeed->leftChannel.isPrepared())
+        return;
+
+    auto lastChannel = buffer.getNumChannels() - 1;
+    if (lastChannel < 0)
+        return;
+
+    auto numSamples = buffer.getNumSamples();
+    analyzerFeed->leftChannel.push(buffer.getReadPointer(juce::jmin((int)Channel::Left, lastChannel)), numSamples);
+    analyzerFeed->rightChannel.push(buffer.getReadPointer(juce::jmin((int)Channel::Right, lastChannel)), numSamples);
+}
+
+
+SimpleQAudioProcessor::AnalyzerFeed& SimpleQAudioProcessor::acquireAnalyzerFeed()
+{
+    if (analyzerFeedUsers++ == 0)
+    {
+        // Allocate before taking the lock, the audio thread only waits for the swap
+        auto feed = std::make_unique<AnalyzerFeed>();
+        prepareAnalyzerFeed(*feed);
+
+        const juce::ScopedLock sl(getCallbackLock());
+        analyzerFeed = std::move(feed);
+    }
+
+    return *analyzerFeed;
+}
+
+
+void SimpleQAudioProcessor::releaseAnalyzerFeed()
+{
+    jassert(analyzerFeedUsers > 0);
+
+    if (--analyzerFeedUsers == 0)
+    {
+        std::unique_ptr<AnalyzerFeed> feed;
+
+        {
+            const juce::ScopedLock sl(getCallbackLock());
+            std::swap(feed, analyzerFeed);
+        }
+
+        // ...and the feed gets freed here, outside the lock
+    }
+}
+
+
+void SimpleQAudioProcessor::unsubscribeFromAnalyzer()
+{
+    auto previous = analyzerSubscribers.fetch_sub(1, std::memory_order_relaxed);
+    jassertquiet(previous > 0);
+}
+
+
+void SimpleQAudioProcessor::prepareAnalyzerFeed(AnalyzerFeed& feed)
+{
+    auto capacity = getAnalyzerRingCapacity(juce::jmax(getSampleRate(), analyzerMaxSampleRate));
+
+    feed.leftChannel.prepare(capacity);
+    feed.rightChannel.prepare(capacity);
+}
+
+
+juce::String SimpleQAudioProcessor::getMemoryReport() const
+{
+    juce::String report;
+
+    auto addLine = [&report](const juce::String& item, size_t numBytes)
+        {
+            report << item << ": " << (juce::int64)numBytes << " bytes" << juce::newLine;
+        };
+
+    addLine("Processor", sizeof(*this));
+    addLine("Programs", programs.capacity() * sizeof(Program));
+    addLine("Program change FIFO", (size_t)programChanges.getCapacity() * sizeof(ProgramChange));
+
+    if (analyzerFeed != nullptr)
+        addLine("Analyzer feed", sizeof(AnalyzerFeed)
+                                 + analyzerFeed->leftChannel.getNumBytes()
+                                 + analyzerFeed->rightChannel.getNumBytes());
+    else
+        addLine("Analyzer feed (no editor open)", 0);
+
+    return report;
+}
+
+
+void SimpleQAudioProcessor::processChains(juce::dsp::AudioBlock<float>& block)
+{
     // Get the left and right channels
     auto leftBlock = block.getSingleChannelBlock(0);
     auto rightBlock = block.getSingleChannelBlock(1);
@@ -188,12 +555,115 @@ void SimpleQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce
     juce::dsp::ProcessContextReplacing<float> rightContext(rightBlock);
 
     leftChain.process(leftContext);
-    rightChain.process(rightContext);   
+    rightChain.process(rightContext);
+}
+
+
+void SimpleQAudioProcessor::processRenderBlock(juce::dsp::AudioBlock<float>& block, const ChainSettings& targetSettings)
+{
+    if (targetSettings == lastChainSettings)
+    {
+        processChains(block);
+        return;
+    }
+
+    const auto numSamples = (int)block.getNumSamples();
+    const auto startSettings = lastChainSettings;
+
+    for (int start = 0; start < numSamples; start += renderSubBlockSize)
+    {
+        auto length = juce::jmin(renderSubBlockSize, numSamples - start);
+
+        // Aim each sub-block at where the glide should be by its last sample,
+        // so the final sub-block lands exactly on the target settings
+        auto proportion = float(start + length) / float(numSamples);
+        updateFilters(interpolateChainSettings(startSettings, targetSettings, proportion));
+
+        auto subBlock = block.getSubBlock((size_t)start, (size_t)length);
+        processChains(subBlock);
+    }
+
+    lastChainSettings = targetSettings;
+}
+
+
+void SimpleQAudioProcessor::handleProgramChanges()
+{
+    // Only the most recent request matters
+    ProgramChange change;
+    bool hasChange = false;
+
+    while (programChanges.getNumAvailableForReading() > 0)
+        hasChange = programChanges.pull(change) || hasChange;
+
+    // A snapshot designed for another sample rate is useless here; the parameters
+    // have been set anyway, so the regular path will pick them up
+    if (!hasChange || change.snapshot.sampleRate != getSampleRate())
+        return;
+
+    if (change.morphLengthInSamples > 0)
+    {
+        // Starting from what's running right now (even halfway through another
+        // morph) keeps the transition continuous
+        morph.from = captureSnapshot(leftChain);
+        morph.to = change.snapshot;
+        morph.lengthInSamples = change.morphLengthInSamples;
+        morph.samplesDone = 0;
+
+        // Stages that are about to fade in have been bypassed, so their state is stale
+        auto resetFadingInStages = [this](Filter& filter, int stage)
+            {
+                if (!morph.from.active[(size_t)stage] && morph.to.active[(size_t)stage])
+                    filter.reset();
+            };
+
+        visitStages(leftChain, resetFadingInStages);
+        visitStages(rightChain, resetFadingInStages);
+    }
+    else
+    {
+        morph = ChainMorph();
 
+        applySnapshot(leftChain, change.snapshot);
+        applySnapshot(rightChain, change.snapshot);
+        lastChainSettings = change.snapshot.settings;
+        coefficientsChanged = true;
+    }
+}
+
+
+void SimpleQAudioProcessor::processMorphBlock(juce::dsp::AudioBlock<float>& block)
+{
+    const auto numSamples = (int)block.getNumSamples();
 
-    leftChannelFifo.update(buffer);
-    rightChannelFifo.update(buffer);
+    coefficientsChanged = true;
 
+    for (int start = 0; start < numSamples; start += morphSubBlockSize)
+    {
+        auto length = juce::jmin(morphSubBlockSize, numSamples - start);
+
+        if (morph.isActive())
+        {
+            morph.samplesDone = juce::jmin(morph.samplesDone + length, morph.lengthInSamples);
+
+            if (morph.isActive())
+            {
+                auto snapshot = interpolateSnapshots(morph.from, morph.to, morph.getProportion());
+                applySnapshot(leftChain, snapshot);
+                applySnapshot(rightChain, snapshot);
+            }
+            else
+            {
+                // Land exactly on the target, which also bypasses the stages that faded out
+                applySnapshot(leftChain, morph.to);
+                applySnapshot(rightChain, morph.to);
+                lastChainSettings = morph.to.settings;
+            }
+        }
+
+        auto subBlock = block.getSubBlock((size_t)start, (size_t)length);
+        processChains(subBlock);
+    }
 }
 
 //==============================================================================
@@ -218,8 +688,15 @@ void SimpleQAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
     // You could do that either as raw data, or use the XML or ValueTree classes
     // as intermediaries to make it easy to save and load complex data.
 
+    const auto& parameterIDs = getStateParameterIDs();
+
     juce::MemoryOutputStream memoryos(destData, true);
-    apvts.state.writeToStream(memoryos);
+    memoryos.writeInt(stateMagic);
+    memoryos.writeShort((short)stateVersion);
+    memoryos.writeShort((short)parameterIDs.size());
+
+    for (const auto& parameterID : parameterIDs)
+        memoryos.writeFloat(apvts.getRawParameterValue(parameterID)->load());
 }
 
 void SimpleQAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
@@ -227,13 +704,77 @@ void SimpleQAudioProcessor::setStateInformation (const void* data, int sizeInByt
     // You should use this method to restore your parameters from this memory block,
     // whose contents will have been created by the getStateInformation() call.
 
-    auto tree = juce::ValueTree::readFromData(data, sizeInBytes);
-    if (tree.isValid())
+    SIMPLEQ_LOG_SCOPE_TIME("SimpleQ state restore")
+
+    if (!restoreBinaryState(data, sizeInBytes))
     {
+        // Sessions saved before the binary format hold the whole ValueTree. Anything
+        // else, like a binary state from a newer version, leaves the parameters alone.
+        auto tree = juce::ValueTree::readFromData(data, sizeInBytes);
+        if (!tree.isValid() || !tree.hasType(apvts.state.getType()))
+            return;
+
         apvts.replaceState(tree);
-        updateFilters();
     }
 
+    // Design the restored settings here rather than on the audio thread
+    CoefficientSnapshot snapshot;
+    snapshot.settings = getChainSettings(apvts);
+    queueSnapshot(snapshot, 0);
+}
+
+
+const juce::StringArray& SimpleQAudioProcessor::getStateParameterIDs()
+{
+    static const juce::StringArray parameterIDs{ "LowCut Freq",
+                                                 "HighCut Freq",
+                                                 "Peak Freq",
+                                                 "Peak Gain",
+                                                 "Peak Quality",
+                                                 "LowCut Slope",
+                                                 "HighCut Slope",
+                                                 "LowCut Bypassed",
+                                                 "Peak Bypassed",
+                                                 "HighCut Bypassed",
+                                                 "Analyzer Enabled",
+                                                 "Morph Time" };
+    return parameterIDs;
+}
+
+
+bool SimpleQAudioProcessor::restoreBinaryState(const void* data, int sizeInBytes)
+{
+    if (data == nullptr || sizeInBytes < stateHeaderSize)
+        return false;
+
+    juce::MemoryInputStream stream(data, (size_t)sizeInBytes, false);
+
+    if (stream.readInt() != stateMagic)
+        return false;
+
+    auto version = (int)stream.readShort();
+    auto numValues = (int)(juce::uint16)stream.readShort();
+
+    // A newer layout may mean anything, so it isn't guessed at. Every version so far
+    // only appended parameters, which the loop below copes with.
+    if (version < 1 || version > stateVersion)
+        return false;
+
+    const auto& parameterIDs = getStateParameterIDs();
+    numValues = juce::jmin(numValues, (sizeInBytes - stateHeaderSize) / (int)sizeof(float));
+
+    for (int i = 0; i < parameterIDs.size(); ++i)
+    {
+        auto* param = apvts.getParameter(parameterIDs[i]);
+
+        // Anything an older version didn't store goes back to its default
+        auto normalisedValue = i < numValues ? param->convertTo0to1(stream.readFloat())
+                                             : param->getDefaultValue();
+
+        param->setValueNotifyingHost(normalisedValue);
+    }
+
+    return true;
 }
 
 
@@ -259,6 +800,44 @@ ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts)
 }
 
 
+const juce::StringArray& getChainSettingsParameterIDs()
+{
+    static const juce::StringArray parameterIDs{ "LowCut Freq",
+                                                 "HighCut Freq",
+                                                 "Peak Freq",
+                                                 "Peak Gain",
+                                                 "Peak Quality",
+                                                 "LowCut Slope",
+                                                 "HighCut Slope",
+                                                 "LowCut Bypassed",
+                                                 "Peak Bypassed",
+                                                 "HighCut Bypassed" };
+    return parameterIDs;
+}
+
+
+ChainSettings interpolateChainSettings(const ChainSettings& start, const ChainSettings& end, float proportion)
+{
+    auto logInterpolate = [proportion](float a, float b)
+        {
+            if (a <= 0.f || b <= 0.f)
+                return b;
+
+            return a * std::pow(b / a, proportion);
+        };
+
+    auto settings = end;
+
+    settings.lowCutFreq = logInterpolate(start.lowCutFreq, end.lowCutFreq);
+    settings.highCutFreq = logInterpolate(start.highCutFreq, end.highCutFreq);
+    settings.peakFreq = logInterpolate(start.peakFreq, end.peakFreq);
+    settings.peakQuality = logInterpolate(start.peakQuality, end.peakQuality);
+    settings.peakGainInDecibels = juce::jmap(proportion, start.peakGainInDecibels, end.peakGainInDecibels);
+
+    return settings;
+}
+
+
 
 Coefficients makePeakFilter(const ChainSettings& chainSettings, double sampleRate)
 {
@@ -307,6 +886,157 @@ void SimpleQAudioProcessor::updateLowCutFilters(const ChainSettings& chainSettin
 
 
 
+CoefficientSnapshot makeCoefficientSnapshot(const ChainSettings& chainSettings, double sampleRate)
+{
+    CoefficientSnapshot snapshot;
+    snapshot.settings = chainSettings;
+    snapshot.sampleRate = sampleRate;
+
+    if (sampleRate <= 0.0)
+        return snapshot;
+
+    auto copyStage = [&snapshot](int stage, const Coefficients& coefficients)
+        {
+            jassert(coefficients->coefficients.size() == (int)CoefficientSnapshot::identity.size());
+
+            auto* raw = coefficients->getRawCoefficients();
+            std::copy(raw, raw + CoefficientSnapshot::identity.size(), snapshot.stages[(size_t)stage].begin());
+            snapshot.active[(size_t)stage] = true;
+        };
+
+    auto copyCutStages = [&copyStage](int firstStage, const auto& cutCoefficients, Slope slope)
+        {
+            for (int i = 0; i <= (int)slope; ++i)
+                copyStage(firstStage + i, cutCoefficients[i]);
+        };
+
+    if (!chainSettings.lowCutBypassed)
+        copyCutStages(CoefficientSnapshot::lowCutStart, makeLowCutFilter(chainSettings, sampleRate), chainSettings.lowCutSlope);
+
+    if (!chainSettings.peakBypassed)
+        copyStage(CoefficientSnapshot::peakStage, makePeakFilter(chainSettings, sampleRate));
+
+    if (!chainSettings.highCutBypassed)
+        copyCutStages(CoefficientSnapshot::highCutStart, makeHighCutFilter(chainSettings, sampleRate), chainSettings.highCutSlope);
+
+    return snapshot;
+}
+
+
+
+CoefficientSnapshot captureSnapshot(const MonoChain& chain)
+{
+    CoefficientSnapshot snapshot;
+
+    const auto& lowCut = chain.get<ChainPositions::LowCut>();
+    const auto& highCut = chain.get<ChainPositions::HighCut>();
+    const bool lowCutOn = !chain.isBypassed<ChainPositions::LowCut>();
+    const bool highCutOn = !chain.isBypassed<ChainPositions::HighCut>();
+
+    snapshot.active = { lowCutOn && !lowCut.isBypassed<0>(),
+                        lowCutOn && !lowCut.isBypassed<1>(),
+                        lowCutOn && !lowCut.isBypassed<2>(),
+                        lowCutOn && !lowCut.isBypassed<3>(),
+                        !chain.isBypassed<ChainPositions::Peak>(),
+                        highCutOn && !highCut.isBypassed<0>(),
+                        highCutOn && !highCut.isBypassed<1>(),
+                        highCutOn && !highCut.isBypassed<2>(),
+                        highCutOn && !highCut.isBypassed<3>() };
+
+    visitStages(chain, [&snapshot](const Filter& filter, int stage)
+        {
+            if (!snapshot.active[(size_t)stage] || filter.coefficients->coefficients.size() != (int)CoefficientSnapshot::identity.size())
+            {
+                snapshot.active[(size_t)stage] = false;
+                return;
+            }
+
+            auto* raw = filter.coefficients->getRawCoefficients();
+            std::copy(raw, raw + CoefficientSnapshot::identity.size(), snapshot.stages[(size_t)stage].begin());
+        });
+
+    return snapshot;
+}
+
+
+
+void prepareStagesForSnapshots(MonoChain& chain)
+{
+    visitStages(chain, [](Filter& filter, int)
+        {
+            if (filter.coefficients->coefficients.size() != (int)CoefficientSnapshot::identity.size())
+                filter.coefficients = new juce::dsp::IIR::Coefficients<float>(1.f, 0.f, 0.f, 1.f, 0.f, 0.f);
+        });
+}
+
+
+
+void applySnapshot(MonoChain& chain, const CoefficientSnapshot& snapshot)
+{
+    visitStages(chain, [&snapshot](Filter& filter, int stage)
+        {
+            if (!snapshot.active[(size_t)stage])
+                return;
+
+            jassert(filter.coefficients->coefficients.size() == (int)CoefficientSnapshot::identity.size());
+
+            const auto& biquad = snapshot.stages[(size_t)stage];
+            std::copy(biquad.begin(), biquad.end(), filter.coefficients->getRawCoefficients());
+        });
+
+    const auto& active = snapshot.active;
+
+    auto& lowCut = chain.get<ChainPositions::LowCut>();
+    lowCut.setBypassed<0>(!active[CoefficientSnapshot::lowCutStart + 0]);
+    lowCut.setBypassed<1>(!active[CoefficientSnapshot::lowCutStart + 1]);
+    lowCut.setBypassed<2>(!active[CoefficientSnapshot::lowCutStart + 2]);
+    lowCut.setBypassed<3>(!active[CoefficientSnapshot::lowCutStart + 3]);
+
+    auto& highCut = chain.get<ChainPositions::HighCut>();
+    highCut.setBypassed<0>(!active[CoefficientSnapshot::highCutStart + 0]);
+    highCut.setBypassed<1>(!active[CoefficientSnapshot::highCutStart + 1]);
+    highCut.setBypassed<2>(!active[CoefficientSnapshot::highCutStart + 2]);
+    highCut.setBypassed<3>(!active[CoefficientSnapshot::highCutStart + 3]);
+
+    auto anyActive = [&active](int firstStage)
+        {
+            return std::any_of(active.begin() + firstStage,
+                               active.begin() + firstStage + CoefficientSnapshot::numCutStages,
+                               [](bool isActive) { return isActive; });
+        };
+
+    chain.setBypassed<ChainPositions::LowCut>(!anyActive(CoefficientSnapshot::lowCutStart));
+    chain.setBypassed<ChainPositions::Peak>(!active[CoefficientSnapshot::peakStage]);
+    chain.setBypassed<ChainPositions::HighCut>(!anyActive(CoefficientSnapshot::highCutStart));
+}
+
+
+
+CoefficientSnapshot interpolateSnapshots(const CoefficientSnapshot& from, const CoefficientSnapshot& to, float proportion)
+{
+    CoefficientSnapshot snapshot;
+    snapshot.settings = to.settings;
+    snapshot.sampleRate = to.sampleRate;
+
+    for (size_t stage = 0; stage < (size_t)CoefficientSnapshot::numStages; ++stage)
+    {
+        if (!from.active[stage] && !to.active[stage])
+            continue;
+
+        const auto& a = from.active[stage] ? from.stages[stage] : CoefficientSnapshot::identity;
+        const auto& b = to.active[stage] ? to.stages[stage] : CoefficientSnapshot::identity;
+
+        for (size_t i = 0; i < a.size(); ++i)
+            snapshot.stages[stage][i] = a[i] + proportion * (b[i] - a[i]);
+
+        snapshot.active[stage] = true;
+    }
+
+    return snapshot;
+}
+
+
+
 void SimpleQAudioProcessor::updateHighCutFilters(const ChainSettings& chainSettings)
 {
 	auto highcutCoefficients = makeHighCutFilter(chainSettings, getSampleRate());
@@ -323,10 +1053,17 @@ void SimpleQAudioProcessor::updateHighCutFilters(const ChainSettings& chainSetti
 
 void SimpleQAudioProcessor::updateFilters()
 {
-	auto chainSettings = getChainSettings(apvts);
+	updateFilters(getChainSettings(apvts));
+}
+
+
+void SimpleQAudioProcessor::updateFilters(const ChainSettings& chainSettings)
+{
 	updateLowCutFilters(chainSettings);
 	updatePeakFilter(chainSettings);
 	updateHighCutFilters(chainSettings);
+
+    coefficientsChanged = true;
 }
 
 
@@ -404,6 +1141,12 @@ juce::AudioProcessorValueTreeState::ParameterLayout SimpleQAudioProcessor::creat
                                                           "Analyzer Enabled",
 												          true));
 
+    // How long program changes and A/B switches take to morph into the new settings
+    layout.add(std::make_unique<juce::AudioParameterFloat>("Morph Time",
+                                                           "Morph Time",
+                                                           juce::NormalisableRange<float>(0.f, 5000.f, 1.f, 0.3f),
+                                                           0.f));
+
 	return layout;
 }
 
@@ -12,6 +12,38 @@
 #include <array>
 
 
+//==============================================================================
+// Build with SIMPLEQ_ENABLE_PROFILING=1 to have the state restore log how long each
+// call took, and the editor how long it took to open, along with a memory report.
+#ifndef SIMPLEQ_ENABLE_PROFILING
+ #define SIMPLEQ_ENABLE_PROFILING 0
+#endif
+
+// Logs the time from its construction to the end of the scope. Nothing is shared
+// between calls, so instances restored on several threads at once don't get in
+// each other's way.
+struct ScopedTimeLogger
+{
+    explicit ScopedTimeLogger(const char* scopeName) : name(scopeName) {}
+
+    ~ScopedTimeLogger()
+    {
+        juce::Logger::writeToLog(juce::String(name) + " took "
+                                 + juce::String(juce::Time::getMillisecondCounterHiRes() - startMs, 3) + " ms");
+    }
+
+private:
+    const char* name;
+    const double startMs = juce::Time::getMillisecondCounterHiRes();
+};
+
+#if SIMPLEQ_ENABLE_PROFILING
+ #define SIMPLEQ_LOG_SCOPE_TIME(name) \
+    const ScopedTimeLogger JUCE_JOIN_MACRO(scopedTimeLogger, __LINE__) { name };
+#else
+ #define SIMPLEQ_LOG_SCOPE_TIME(name)
+#endif
+
 //==============================================================================
 
 
@@ -19,6 +51,23 @@
 template<typename T>
 struct Fifo
 {
+    explicit Fifo(int numSlots = 30)
+    {
+        setCapacity(numSlots);
+    }
+
+    // Reallocates the slots, so only call this while nothing else is using the Fifo.
+    // The Fifo can hold numSlots - 1 items at a time.
+    void setCapacity(int numSlots)
+    {
+        jassert(numSlots > 1);
+        buffers.clear();
+        buffers.resize((size_t)numSlots);
+        fifo.setTotalSize(numSlots);
+    }
+
+    int getCapacity() const { return (int)buffers.size(); }
+
     void prepare(int numChannels, int numSamples)
     {
         static_assert(std::is_same_v<T, juce::AudioBuffer<float>>,
@@ -47,10 +96,10 @@ struct Fifo
 
     bool push(const T& t)
     {
-        auto write = fifo.write(1);
-        if (write.blockSize1 > 0)
+        if (auto* slot = beginWrite())
         {
-            buffers[write.startIndex1] = t;
+            *slot = t;
+            finishWrite();
             return true;
         }
 
@@ -59,26 +108,109 @@ struct Fifo
 
     bool pull(T& t)
     {
-        auto read = fifo.read(1);
-        if (read.blockSize1 > 0)
+        if (auto* slot = beginRead())
+        {
+            t = *slot;
+            finishRead();
+            return true;
+        }
+
+        return false;
+    }
+
+    // Hands over t's contents and gets the slot's previous ones back, so with
+    // preallocated slots and items nothing is copied or allocated
+    bool pushBySwapping(T& t)
+    {
+        if (auto* slot = beginWrite())
         {
-            t = buffers[read.startIndex1];
+            std::swap(*slot, t);
+            finishWrite();
             return true;
         }
 
         return false;
     }
 
+    bool pullBySwapping(T& t)
+    {
+        if (auto* slot = beginRead())
+        {
+            std::swap(*slot, t);
+            finishRead();
+            return true;
+        }
+
+        return false;
+    }
+
+    // In-place access: fill the slot beginWrite() returns, then finishWrite() publishes it.
+    // Returns nullptr (and counts an overflow) if the Fifo is full.
+    T* beginWrite()
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+        if (size1 > 0)
+            return &buffers[(size_t)start1];
+
+        numOverflows.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    void finishWrite() { fifo.finishedWrite(1); }
+
+    // Returns nullptr (and counts an underflow) if nothing is ready,
+    // so poll getNumAvailableForReading() first when that's expected.
+    T* beginRead()
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(1, start1, size1, start2, size2);
+
+        if (size1 > 0)
+            return &buffers[(size_t)start1];
+
+        numUnderflows.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    void finishRead() { fifo.finishedRead(1); }
+
     int getNumAvailableForReading() const
     {
         return fifo.getNumReady();
     }
+
+    // Items dropped because the Fifo was full, and reads that found nothing
+    int getNumOverflows() const { return numOverflows.load(std::memory_order_relaxed); }
+    int getNumUnderflows() const { return numUnderflows.load(std::memory_order_relaxed); }
 private:
-    static constexpr int Capacity = 30;
-    std::array<T, Capacity> buffers;
-    juce::AbstractFifo fifo{ Capacity };
+    std::vector<T> buffers;
+    juce::AbstractFifo fifo{ 2 };
+
+    std::atomic<int> numOverflows{ 0 }, numUnderflows{ 0 };
 };
 
+// The rate the editor refreshes the analyzer at, and the longest window it ever reads
+constexpr int analyzerFrameRateHz = 60;
+constexpr int analyzerMaxWindowSize = 1 << 13;
+
+// The analyzer hops by at most half a window, so a window can end that far behind the write position
+constexpr int analyzerMaxHopSize = analyzerMaxWindowSize / 2;
+
+// The analyzer feed is sized for this rate when it's created and never reallocated
+// afterwards, since the analysis workers may be reading it at any time. Above it,
+// there's less slack for the message thread falling behind, but it still works.
+constexpr double analyzerMaxSampleRate = 192000.0;
+
+// The longest analysis window and hop plus two display frames' worth of
+// samples, in case the message thread falls behind a frame
+inline int getAnalyzerRingCapacity(double sampleRate)
+{
+    auto samplesPerFrame = sampleRate > 0.0 ? (int)std::ceil(sampleRate / analyzerFrameRateHz) : 0;
+    return analyzerMaxWindowSize + analyzerMaxHopSize + 2 * samplesPerFrame;
+}
+
 enum Channel
 {
     Right, //effectively 0
@@ -90,68 +222,137 @@ enum Channel
 
 
 
-template<typename BlockType>
-struct SingleChannelSampleFifo
+// A single-producer/single-consumer history of one channel's samples.
+// The audio thread appends whole blocks (one or two bulk copies, never waiting
+// for the reader), and the analyzer reads any window it likes out of the
+// most recent getCapacity() samples. Positions are absolute sample counts.
+struct SampleRing
 {
-    SingleChannelSampleFifo(Channel ch) : channelToUse(ch)
+    // Allocates, so only call this before the ring is shared with the writer or a reader.
+    // Keeps the existing history if it's already big enough.
+    void prepare(int minimumCapacity)
     {
-        prepared.set(false);
+        auto capacity = juce::nextPowerOfTwo(juce::jmax(minimumCapacity, 2));
+
+        if (capacity <= getCapacity())
+            return;
+
+        buffer.assign((size_t)capacity, 0.f);
+        mask = capacity - 1;
+        reset();
     }
 
-    void update(const BlockType& buffer)
+    // Starts the history over at position 0 without touching the storage, e.g. when the
+    // stream restarts at another sample rate. Only while the audio thread isn't pushing;
+    // readers notice through getGeneration() and drop whatever they were in the middle of.
+    void reset()
     {
-        jassert(prepared.get());
-        jassert(buffer.getNumChannels() > channelToUse);
-        auto* channelPtr = buffer.getReadPointer(channelToUse);
+        writePosition.store(0);
+        pendingWriteEnd.store(0);
+        readPosition.store(0);
+        numSamplesOverwritten.store(0);
+        generation.fetch_add(1, std::memory_order_release);
+    }
+
+    juce::uint32 getGeneration() const { return generation.load(std::memory_order_acquire); }
 
-        for (int i = 0; i < buffer.getNumSamples(); ++i)
+    bool isPrepared() const { return !buffer.empty(); }
+    int getCapacity() const { return (int)buffer.size(); }
+    size_t getNumBytes() const { return buffer.size() * sizeof(float); }
+
+    // Audio thread only
+    void push(const float* samples, int numSamples)
+    {
+        jassert(isPrepared() && numSamples >= 0);
+
+        auto write = writePosition.load(std::memory_order_relaxed);
+        const auto capacity = getCapacity();
+
+        // Only the newest 'capacity' samples of an oversized block can survive anyway
+        if (numSamples > capacity)
         {
-            pushNextSampleIntoFifo(channelPtr[i]);
+            samples += numSamples - capacity;
+            write += numSamples - capacity;
+            numSamples = capacity;
         }
-    }
 
-    void prepare(int bufferSize)
-    {
-        prepared.set(false);
-        size.set(bufferSize);
-
-        bufferToFill.setSize(1,             //channel
-            bufferSize,    //num samples
-            false,         //keepExistingContent
-            true,          //clear extra space
-            true);         //avoid reallocating
-        audioBufferFifo.prepare(1, bufferSize);
-        fifoIndex = 0;
-        prepared.set(true);
+        auto start = (int)(write & mask);
+        auto numToEnd = juce::jmin(numSamples, capacity - start);
+
+        // Claims the samples about to be overwritten before touching them, so that a
+        // reader copying them right now can tell (see read())
+        pendingWriteEnd.store(write + numSamples, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        juce::FloatVectorOperations::copy(buffer.data() + start, samples, numToEnd);
+        juce::FloatVectorOperations::copy(buffer.data(), samples + numToEnd, numSamples - numToEnd);
+
+        // Count what the reader never got to before it was overwritten
+        auto unread = write + numSamples - readPosition.load(std::memory_order_relaxed);
+        if (unread > capacity)
+            numSamplesOverwritten.fetch_add(juce::jmin(unread - capacity, (juce::int64)numSamples), std::memory_order_relaxed);
+
+        writePosition.store(write + numSamples, std::memory_order_release);
     }
-    //==============================================================================
-    int getNumCompleteBuffersAvailable() const { return audioBufferFifo.getNumAvailableForReading(); }
-    bool isPrepared() const { return prepared.get(); }
-    int getSize() const { return size.get(); }
-    //==============================================================================
-    bool getAudioBuffer(BlockType& buf) { return audioBufferFifo.pull(buf); }
-private:
-    Channel channelToUse;
-    int fifoIndex = 0;
-    Fifo<BlockType> audioBufferFifo;
-    BlockType bufferToFill;
-    juce::Atomic<bool> prepared = false;
-    juce::Atomic<int> size = 0;
-
-    void pushNextSampleIntoFifo(float sample)
+
+    // The position just after the newest sample
+    juce::int64 getWritePosition() const { return writePosition.load(std::memory_order_acquire); }
+
+    // How far the reader has got. It only feeds the overwrite count, so the reader
+    // may skip ahead freely; it just means the skipped samples aren't counted.
+    juce::int64 getReadPosition() const { return readPosition.load(std::memory_order_relaxed); }
+    void setReadPosition(juce::int64 position) { readPosition.store(position, std::memory_order_relaxed); }
+
+    // Samples that were overwritten before the reader got to them, i.e. the analyzer fell behind
+    juce::int64 getNumSamplesOverwritten() const { return numSamplesOverwritten.load(std::memory_order_relaxed); }
+
+    // Copies the numSamples ending at endPosition into dest. Anything from before
+    // the first sample was written reads as silence. Returns false if part of the
+    // window hasn't been written yet, or was overwritten before we got to it.
+    bool read(juce::int64 endPosition, float* dest, int numSamples) const
     {
-        if (fifoIndex == bufferToFill.getNumSamples())
-        {
-            auto ok = audioBufferFifo.push(bufferToFill);
+        const auto capacity = getCapacity();
+        jassert(numSamples <= capacity);
 
-            juce::ignoreUnused(ok);
+        if (!isPrepared() || endPosition > getWritePosition() || numSamples > capacity)
+            return false;
 
-            fifoIndex = 0;
+        auto startPosition = endPosition - numSamples;
+
+        if (startPosition < 0)
+        {
+            auto numSilent = (int)juce::jmin((juce::int64)numSamples, -startPosition);
+            juce::FloatVectorOperations::clear(dest, numSilent);
+            dest += numSilent;
+            numSamples -= numSilent;
+            startPosition = 0;
         }
 
-        bufferToFill.setSample(0, fifoIndex, sample);
-        ++fifoIndex;
+        if (getWritePosition() - startPosition > capacity)
+            return false;
+
+        auto start = (int)(startPosition & mask);
+        auto numToEnd = juce::jmin(numSamples, capacity - start);
+
+        juce::FloatVectorOperations::copy(dest, buffer.data() + start, numToEnd);
+        juce::FloatVectorOperations::copy(dest + numToEnd, buffer.data(), numSamples - numToEnd);
+
+        // The writer never waits, so check it didn't lap us while we were copying,
+        // counting the block it may still be in the middle of copying in
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return pendingWriteEnd.load(std::memory_order_relaxed) - startPosition <= capacity;
     }
+
+private:
+    std::vector<float> buffer;
+    juce::int64 mask = 0;
+
+    // On separate cache lines, so the reader and the writer don't contend
+    alignas(64) std::atomic<juce::int64> writePosition{ 0 };
+    std::atomic<juce::int64> pendingWriteEnd{ 0 };
+    std::atomic<juce::int64> numSamplesOverwritten{ 0 };
+    std::atomic<juce::uint32> generation{ 0 };
+    alignas(64) std::atomic<juce::int64> readPosition{ 0 };
 };
 
 
@@ -171,10 +372,33 @@ struct ChainSettings
     Slope lowCutSlope{ Slope::Slope_12 }, highCutSlope{ Slope::Slope_12 };
 
     bool lowCutBypassed{ false }, peakBypassed{ false }, highCutBypassed{ false };
+
+    bool operator==(const ChainSettings& other) const
+    {
+        return peakFreq == other.peakFreq
+            && peakGainInDecibels == other.peakGainInDecibels
+            && peakQuality == other.peakQuality
+            && lowCutFreq == other.lowCutFreq
+            && highCutFreq == other.highCutFreq
+            && lowCutSlope == other.lowCutSlope
+            && highCutSlope == other.highCutSlope
+            && lowCutBypassed == other.lowCutBypassed
+            && peakBypassed == other.peakBypassed
+            && highCutBypassed == other.highCutBypassed;
+    }
+
+    bool operator!=(const ChainSettings& other) const { return !(*this == other); }
 };
 
 ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts);
 
+// The parameters getChainSettings() reads, i.e. the ones that change the filters
+const juce::StringArray& getChainSettingsParameterIDs();
+
+// Glides from 'start' towards 'end' (proportion 0..1). Frequencies and Q move
+// on a log scale so sweeps sound even, the discrete settings jump straight to 'end'.
+ChainSettings interpolateChainSettings(const ChainSettings& start, const ChainSettings& end, float proportion);
+
 using Filter = juce::dsp::IIR::Filter<float>;
 
 using CutFilter = juce::dsp::ProcessorChain<Filter, Filter, Filter, Filter>;
@@ -249,10 +473,154 @@ inline auto makeHighCutFilter(const ChainSettings& chainSettings, double sampleR
 }
 
 
+//==============================================================================
+// Every biquad of a MonoChain, already designed for one sample rate.
+// Designing filters allocates, so snapshots are made off the audio thread;
+// applying or interpolating one on the audio thread is just copying floats.
+struct CoefficientSnapshot
+{
+    // b0, b1, b2, a1, a2 normalised by a0, the layout JUCE uses for a 2nd order filter
+    using Biquad = std::array<float, 5>;
+    static constexpr Biquad identity{ 1.f, 0.f, 0.f, 0.f, 0.f };
+
+    // Stage order: the four low cut stages, the peak, then the four high cut stages
+    static constexpr int numCutStages = 4;
+    static constexpr int lowCutStart = 0;
+    static constexpr int peakStage = lowCutStart + numCutStages;
+    static constexpr int highCutStart = peakStage + 1;
+    static constexpr int numStages = highCutStart + numCutStages;
+
+    CoefficientSnapshot()
+    {
+        stages.fill(identity);
+        active.fill(false);
+    }
+
+    std::array<Biquad, numStages> stages;
+    std::array<bool, numStages> active;
+
+    ChainSettings settings;
+    double sampleRate = 0.0;
+};
+
+CoefficientSnapshot makeCoefficientSnapshot(const ChainSettings& chainSettings, double sampleRate);
+
+// Reads back whatever the chain is currently running, including mid-morph coefficients
+CoefficientSnapshot captureSnapshot(const MonoChain& chain);
+
+// Writes the snapshot into the chain's existing coefficient objects, so it doesn't allocate
+// once every stage holds 2nd order coefficients (see prepareStagesForSnapshots).
+void applySnapshot(MonoChain& chain, const CoefficientSnapshot& snapshot);
+
+void prepareStagesForSnapshots(MonoChain& chain);
+
+// Linear interpolation of the raw coefficients. Stages that are off on one side
+// count as an identity biquad. Interpolating a1/a2 between two stable biquads
+// stays inside the (convex) stability triangle, so every step is a stable filter.
+CoefficientSnapshot interpolateSnapshots(const CoefficientSnapshot& from, const CoefficientSnapshot& to, float proportion);
+
+// Calls visitor(filter, stageIndex) for the nine biquads of a MonoChain, in snapshot stage order
+template<typename ChainType, typename Visitor>
+void visitStages(ChainType& chain, Visitor&& visitor)
+{
+    auto& lowCut = chain.template get<ChainPositions::LowCut>();
+    auto& highCut = chain.template get<ChainPositions::HighCut>();
+
+    visitor(lowCut.template get<0>(), CoefficientSnapshot::lowCutStart + 0);
+    visitor(lowCut.template get<1>(), CoefficientSnapshot::lowCutStart + 1);
+    visitor(lowCut.template get<2>(), CoefficientSnapshot::lowCutStart + 2);
+    visitor(lowCut.template get<3>(), CoefficientSnapshot::lowCutStart + 3);
+
+    visitor(chain.template get<ChainPositions::Peak>(), CoefficientSnapshot::peakStage);
+
+    visitor(highCut.template get<0>(), CoefficientSnapshot::highCutStart + 0);
+    visitor(highCut.template get<1>(), CoefficientSnapshot::highCutStart + 1);
+    visitor(highCut.template get<2>(), CoefficientSnapshot::highCutStart + 2);
+    visitor(highCut.template get<3>(), CoefficientSnapshot::highCutStart + 3);
+}
+
+
+// Hands the coefficients the audio thread is running over to the editor.
+// It's a seqlock: publishing never waits or allocates, and a reader that was
+// copying while a publish happened notices and copies again.
+struct PublishedSnapshot
+{
+    // Only ever called from one thread at a time (the audio thread)
+    void publish(const CoefficientSnapshot& newSnapshot)
+    {
+        auto seq = sequence.load(std::memory_order_relaxed);
+
+        // odd while the copy is being written
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        snapshot = newSnapshot;
+
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    // Goes up by one with every publish, 0 means nothing has been published yet
+    juce::uint32 getVersion() const { return sequence.load(std::memory_order_acquire) / 2; }
+
+    // Returns false if it kept being overwritten while copying; try again later
+    bool read(CoefficientSnapshot& dest, juce::uint32& version) const
+    {
+        for (int attempt = 0; attempt < 4; ++attempt)
+        {
+            auto before = sequence.load(std::memory_order_acquire);
+
+            if ((before & 1) != 0)
+                continue;
+
+            dest = snapshot;
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (sequence.load(std::memory_order_relaxed) == before)
+            {
+                version = before / 2;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+private:
+    static_assert(std::is_trivially_copyable_v<CoefficientSnapshot>,
+                  "the snapshot is copied while it may be being written, so it can't own anything");
+
+    std::atomic<juce::uint32> sequence{ 0 };
+    CoefficientSnapshot snapshot;
+};
+
+// A request from the message thread for the audio thread to switch to an already
+// designed snapshot, either straight away or morphing over morphLengthInSamples.
+struct ProgramChange
+{
+    CoefficientSnapshot snapshot;
+    int morphLengthInSamples = 0;
+};
+
+struct ChainMorph
+{
+    CoefficientSnapshot from, to;
+    int lengthInSamples = 0;
+    int samplesDone = 0;
+
+    bool isActive() const { return samplesDone < lengthInSamples; }
+    float getProportion() const { return lengthInSamples > 0 ? float(samplesDone) / float(lengthInSamples) : 1.f; }
+};
+
+
 //==============================================================================
 /**
+    Broadcasts a change message whenever the current program or A/B slot changes,
+    including when the host picked the program. Listen from the message thread only.
 */
-class SimpleQAudioProcessor  : public juce::AudioProcessor
+class SimpleQAudioProcessor  : public juce::AudioProcessor,
+                                public juce::ChangeBroadcaster,
+                                private juce::AsyncUpdater
                             #if JucePlugin_Enable_ARA
                              , public juce::AudioProcessorARAExtension
                             #endif
@@ -295,13 +663,49 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
+    //==============================================================================
+    // Hands the audio thread a snapshot designed here, morphing to it over the
+    // "Morph Time" parameter, then sets the parameters to 'settings'.
+    // Call these from the message thread.
+    void morphTo(const ChainSettings& settings);
+
+    // A/B compare: the edits made on the current slot are kept, then the
+    // chain morphs over to whatever was last dialled in on the other slot.
+    enum ABSlot { SlotA, SlotB };
+    void switchToABSlot(ABSlot slot);
+    ABSlot getCurrentABSlot() const { return currentABSlot; }
+
 
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
     juce::AudioProcessorValueTreeState apvts{ *this, nullptr, "Parameters", createParameterLayout()};
 
     using BlockType = juce::AudioBuffer<float>;
-    SingleChannelSampleFifo<BlockType> leftChannelFifo { Channel::Left };
-    SingleChannelSampleFifo<BlockType> rightChannelFifo { Channel::Right };
+
+    struct AnalyzerFeed
+    {
+        SampleRing leftChannel, rightChannel;
+    };
+
+    // The analyzer FIFOs only exist while an editor holds on to them, so the
+    // hundreds of closed instances in a session don't pay for them at all.
+    // Message thread only; the feed stays valid until the matching release.
+    AnalyzerFeed& acquireAnalyzerFeed();
+    void releaseAnalyzerFeed();
+
+    // Holding the feed isn't enough for the audio thread to fill it: only while
+    // at least one editor with the analyzer switched on is subscribed does
+    // processBlock copy anything into it.
+    void subscribeToAnalyzer() { analyzerSubscribers.fetch_add(1, std::memory_order_relaxed); }
+    void unsubscribeFromAnalyzer();
+    bool hasAnalyzerSubscribers() const { return analyzerSubscribers.load(std::memory_order_relaxed) > 0; }
+
+    // What this instance currently holds on the heap, one line per item
+    juce::String getMemoryReport() const;
+
+    // The coefficients the audio thread is running, published whenever they change.
+    // Drawing from these means the editor never designs filters itself, and the
+    // curve on screen is exactly what's being heard (mid-morph included).
+    const PublishedSnapshot& getPublishedCoefficients() const { return publishedCoefficients; }
   
 
 
@@ -317,6 +721,86 @@ private:
     void updateHighCutFilters(const ChainSettings& chainSettings);
     
     void updateFilters();
+    void updateFilters(const ChainSettings& chainSettings);
+
+    void processChains(juce::dsp::AudioBlock<float>& block);
+
+    // Offline bounces (isNonRealtime()) redesign the filters every
+    // renderSubBlockSize samples instead of once per block, so automation is
+    // rendered as a smooth glide rather than a per-block staircase.
+    // Both modes share the same filter state, so going back to realtime is click-free.
+    void processRenderBlock(juce::dsp::AudioBlock<float>& block, const ChainSettings& targetSettings);
+    static constexpr int renderSubBlockSize = 32;
+
+    // The settings the chains were last updated with, i.e. where the next render glide starts.
+    // The realtime path only redesigns the filters when the parameters move away from these.
+    ChainSettings lastChainSettings;
+
+    //==============================================================================
+    struct Program
+    {
+        juce::String name;
+        CoefficientSnapshot snapshot;
+    };
+
+    std::vector<Program> programs;
+    std::atomic<int> currentProgram{ 0 };
+
+    // Hosts can call setCurrentProgram() from any thread, so the parameters are
+    // only ever set on the message thread, from here
+    std::atomic<int> pendingProgram{ -1 };
+    void handleAsyncUpdate() override;
+
+    std::array<ChainSettings, 2> abSlots;
+    ABSlot currentABSlot = SlotA;
+    bool abSlotsInitialised = false;
+
+    void createFactoryPrograms();
+    ChainSettings snapToParameterGrid(const ChainSettings& settings) const;
+    void setParameters(const ChainSettings& settings);
+    int getMorphLengthInSamples() const;
+    void morphTo(const CoefficientSnapshot& snapshot);
+    void queueSnapshot(const CoefficientSnapshot& snapshot, int morphLengthInSamples);
+
+    // Odd while morphTo() is setting the parameters one by one, and bumped twice by
+    // every call. processBlock() loads it before looking for queued changes and
+    // readChainSettings() checks it again after reading the parameters, like
+    // PublishedSnapshot::read(), so a read that overlapped a morphTo() is thrown
+    // away: the audio thread keeps running what it has rather than designing from a
+    // half-applied set, and the queued snapshot takes it from there.
+    std::atomic<juce::uint32> parameterWriteSequence{ 0 };
+
+    // The parameters as a whole, or lastChainSettings if morphTo() wrote any of
+    // them since parameterWriteSequence read 'before'
+    ChainSettings readChainSettings(juce::uint32 before);
+
+    // The binary state is a small header followed by one float per parameter.
+    // Only ever append to the list of parameters it stores, and bump the version when doing so.
+    static constexpr juce::int32 stateMagic = 0x74735153; // "SQst"
+    static constexpr int stateVersion = 1;
+    static constexpr int stateHeaderSize = 8;
+
+    static const juce::StringArray& getStateParameterIDs();
+    bool restoreBinaryState(const void* data, int sizeInBytes);
+
+    Fifo<ProgramChange> programChanges{ 8 };
+    ChainMorph morph;
+
+    // Set whenever the chains get new coefficients, published at the end of the block
+    PublishedSnapshot publishedCoefficients;
+    bool coefficientsChanged = true;
+    void publishCoefficients();
+
+    // Swapped under the callback lock, so processBlock can just check it for nullptr
+    std::unique_ptr<AnalyzerFeed> analyzerFeed;
+    int analyzerFeedUsers = 0;
+    std::atomic<int> analyzerSubscribers{ 0 };
+    void prepareAnalyzerFeed(AnalyzerFeed& feed);
+    void pushIntoAnalyzerFeed(const juce::AudioBuffer<float>& buffer);
+
+    void handleProgramChanges();
+    void processMorphBlock(juce::dsp::AudioBlock<float>& block);
+    static constexpr int morphSubBlockSize = 32;
 
     juce::dsp::Oscillator<float> osc;
 
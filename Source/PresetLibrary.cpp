@@ -0,0 +1,401 @@
+/*
+  ==============================================================================
+
+    PresetLibrary.cpp
+
+  ==============================================================================
+*/
+
+#include "PresetLibrary.h"
+
+
+namespace
+{
+    // Decodes UTF-8 that isn't null-terminated into lower-cased code points,
+    // never reading past 'numBytes' even if the last sequence is cut short
+    void decodeLowerCase(const char* text, size_t numBytes, std::vector<juce::juce_wchar>& dest)
+    {
+        dest.clear();
+
+        auto* p = reinterpret_cast<const juce::uint8*>(text);
+        auto* end = p + numBytes;
+
+        while (p < end)
+        {
+            auto lead = *p++;
+            auto numExtra = lead >= 0xf0 ? 3 : lead >= 0xe0 ? 2 : lead >= 0xc0 ? 1 : 0;
+            auto c = (juce::juce_wchar)(numExtra == 0 ? lead : lead & (0x3f >> numExtra));
+
+            for (int i = 0; i < numExtra && p < end; ++i)
+                c = (c << 6) | (*p++ & 0x3f);
+
+            dest.push_back(juce::CharacterFunctions::toLowerCase(c));
+        }
+    }
+}
+
+
+PresetLibrary::PresetLibrary()
+{
+    open(getDefaultFile());
+}
+
+
+juce::File PresetLibrary::getDefaultFile()
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("SimpleQ")
+        .getChildFile("Presets.sqbank");
+}
+
+
+bool PresetLibrary::open(const juce::File& fileToOpen)
+{
+    close();
+
+    // Remembered even if it doesn't exist yet, so that save() creates it
+    file = fileToOpen;
+
+    if (!file.existsAsFile())
+        return false;
+
+    auto mapped = std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly);
+    auto* bytes = static_cast<const char*>(mapped->getData());
+    auto size = mapped->getSize();
+
+    if (bytes == nullptr || size < (size_t)headerSize)
+        return false;
+
+    auto readInt = [bytes](size_t offset) { return juce::ByteOrder::littleEndianInt(bytes + offset); };
+
+    if (readInt(0) != magic || readInt(4) < 1)
+        return false;
+
+    const auto count = (juce::uint64)readInt(8);
+    const auto numTags = (juce::uint64)readInt(12);
+    const auto numValues = (juce::uint64)readInt(16);
+    const auto recSize = (juce::uint64)readInt(20);
+    const auto recOffset = (juce::uint64)readInt(24);
+    const auto strOffset = (juce::uint64)readInt(28);
+    const auto strSize = (juce::uint64)readInt(32);
+
+    // Refuse anything that would make us read outside the mapped file
+    if (numTags > (juce::uint64)maxNumTags
+        || (juce::uint64)headerSize + numTags * tagEntrySize > size
+        || recSize < (juce::uint64)recordHeaderSize + numValues * sizeof(float)
+        || recOffset + count * recSize > size
+        || strOffset + strSize > size)
+        return false;
+
+    mappedFile = std::move(mapped);
+    data = bytes;
+    dataSize = size;
+
+    numPresets = (int)count;
+    numValuesPerRecord = (int)numValues;
+    recordSize = (size_t)recSize;
+    recordsOffset = (size_t)recOffset;
+    stringsOffset = (size_t)strOffset;
+    stringsSize = (size_t)strSize;
+
+    for (size_t i = 0; i < (size_t)numTags; ++i)
+    {
+        auto entry = (size_t)headerSize + i * (size_t)tagEntrySize;
+        tagNames.add(getString(readInt(entry), readInt(entry + 4)));
+    }
+
+    return true;
+}
+
+
+void PresetLibrary::close()
+{
+    mappedFile.reset();
+    data = nullptr;
+    dataSize = 0;
+
+    numPresets = 0;
+    numValuesPerRecord = 0;
+    recordSize = recordsOffset = stringsOffset = stringsSize = 0;
+
+    tagNames.clear();
+}
+
+
+const char* PresetLibrary::getRecord(int index) const
+{
+    if (!juce::isPositiveAndBelow(index, numPresets))
+        return nullptr;
+
+    return data + recordsOffset + (size_t)index * recordSize;
+}
+
+
+juce::String PresetLibrary::getString(juce::uint32 offset, juce::uint32 length) const
+{
+    if ((juce::uint64)offset + length > stringsSize)
+        return {};
+
+    return juce::String::fromUTF8(data + stringsOffset + offset, (int)length);
+}
+
+
+juce::String PresetLibrary::getName(int index) const
+{
+    if (auto* record = getRecord(index))
+        return getString(juce::ByteOrder::littleEndianInt(record), juce::ByteOrder::littleEndianInt(record + 4));
+
+    return {};
+}
+
+
+juce::uint32 PresetLibrary::getTagMask(int index) const
+{
+    if (auto* record = getRecord(index))
+        return juce::ByteOrder::littleEndianInt(record + 8);
+
+    return 0;
+}
+
+
+ChainSettings PresetLibrary::getSettings(int index) const
+{
+    auto* record = getRecord(index);
+
+    auto value = [this, record](Value v, float fallback)
+        {
+            if (record == nullptr || v >= numValuesPerRecord)
+                return fallback;
+
+            auto bits = juce::ByteOrder::littleEndianInt(record + recordHeaderSize + (size_t)v * sizeof(float));
+
+            float f;
+            std::memcpy(&f, &bits, sizeof(float));
+            return f;
+        };
+
+    auto slope = [](float v) { return static_cast<Slope>(juce::jlimit(0, 3, juce::roundToInt(v))); };
+
+    ChainSettings settings;
+
+    settings.lowCutFreq = value(LowCutFreq, 20.f);
+    settings.lowCutSlope = slope(value(LowCutSlope, 0.f));
+    settings.lowCutBypassed = value(LowCutBypassed, 0.f) > 0.5f;
+
+    settings.peakFreq = value(PeakFreq, 750.f);
+    settings.peakGainInDecibels = value(PeakGain, 0.f);
+    settings.peakQuality = value(PeakQuality, 1.f);
+    settings.peakBypassed = value(PeakBypassed, 0.f) > 0.5f;
+
+    settings.highCutFreq = value(HighCutFreq, 20000.f);
+    settings.highCutSlope = slope(value(HighCutSlope, 0.f));
+    settings.highCutBypassed = value(HighCutBypassed, 0.f) > 0.5f;
+
+    return settings;
+}
+
+
+PresetLibrary::Preset PresetLibrary::getPreset(int index) const
+{
+    Preset preset;
+    preset.name = getName(index);
+    preset.settings = getSettings(index);
+
+    auto mask = getTagMask(index);
+    for (int i = 0; i < tagNames.size(); ++i)
+        if ((mask & (1u << i)) != 0)
+            preset.tags.add(tagNames[i]);
+
+    return preset;
+}
+
+
+juce::Array<int> PresetLibrary::find(const juce::String& nameFilter, const juce::StringArray& requiredTags) const
+{
+    juce::uint32 requiredMask = 0;
+
+    for (const auto& tag : requiredTags)
+    {
+        auto tagIndex = tagNames.indexOf(tag, true);
+
+        // No preset can carry a tag the bank doesn't know about
+        if (tagIndex < 0)
+            return {};
+
+        requiredMask |= 1u << tagIndex;
+    }
+
+    juce::Array<int> matches;
+    matches.ensureStorageAllocated(numPresets);
+
+    std::vector<juce::juce_wchar> filter, name;
+    decodeLowerCase(nameFilter.toRawUTF8(), nameFilter.getNumBytesAsUTF8(), filter);
+
+    for (int i = 0; i < numPresets; ++i)
+    {
+        if ((getTagMask(i) & requiredMask) != requiredMask)
+            continue;
+
+        if (!filter.empty())
+        {
+            auto* record = getRecord(i);
+            auto offset = juce::ByteOrder::littleEndianInt(record);
+            auto length = juce::ByteOrder::littleEndianInt(record + 4);
+
+            if ((juce::uint64)offset + length > stringsSize)
+                continue;
+
+            // 'name' keeps its storage from one preset to the next
+            decodeLowerCase(data + stringsOffset + offset, length, name);
+
+            if (std::search(name.begin(), name.end(), filter.begin(), filter.end()) == name.end())
+                continue;
+        }
+
+        matches.add(i);
+    }
+
+    return matches;
+}
+
+
+std::vector<PresetLibrary::Preset> PresetLibrary::getPresetsWith(const Preset& preset) const
+{
+    std::vector<Preset> presets;
+    presets.reserve((size_t)numPresets + 1);
+
+    for (int i = 0; i < numPresets; ++i)
+    {
+        auto existing = getPreset(i);
+        if (!existing.name.equalsIgnoreCase(preset.name))
+            presets.push_back(existing);
+    }
+
+    presets.push_back(preset);
+    return presets;
+}
+
+
+bool PresetLibrary::collectTags(const std::vector<Preset>& presets, juce::StringArray& tags)
+{
+    for (const auto& preset : presets)
+    {
+        for (const auto& tag : preset.tags)
+        {
+            if (tags.contains(tag, true))
+                continue;
+
+            if (tags.size() >= maxNumTags)
+                return false;
+
+            tags.add(tag);
+        }
+    }
+
+    return true;
+}
+
+
+bool PresetLibrary::hasRoomForTags(const Preset& preset) const
+{
+    juce::StringArray tags;
+    return collectTags(getPresetsWith(preset), tags);
+}
+
+
+bool PresetLibrary::save(const Preset& preset)
+{
+    auto presets = getPresetsWith(preset);
+
+    // Nothing is written rather than quietly dropping tags
+    juce::StringArray tags;
+    if (!collectTags(presets, tags))
+        return false;
+
+    auto target = file;
+
+    // Some platforms won't replace a file that is still mapped
+    close();
+    auto ok = write(target, presets);
+    open(target);
+
+    sendSynchronousChangeMessage();
+
+    return ok;
+}
+
+
+bool PresetLibrary::write(const juce::File& fileToWrite, const std::vector<Preset>& presets)
+{
+    juce::StringArray tags;
+
+    if (!collectTags(presets, tags))
+        return false;
+
+    juce::MemoryOutputStream strings, tagTable, records;
+
+    auto addString = [&strings](juce::MemoryOutputStream& dest, const juce::String& str)
+        {
+            auto numBytes = str.getNumBytesAsUTF8();
+            dest.writeInt((int)strings.getDataSize());
+            dest.writeInt((int)numBytes);
+            strings.write(str.toRawUTF8(), numBytes);
+        };
+
+    for (const auto& tag : tags)
+        addString(tagTable, tag);
+
+    for (const auto& preset : presets)
+    {
+        juce::uint32 mask = 0;
+        for (const auto& tag : preset.tags)
+        {
+            auto tagIndex = tags.indexOf(tag, true);
+            if (tagIndex >= 0)
+                mask |= 1u << tagIndex;
+        }
+
+        addString(records, preset.name);
+        records.writeInt((int)mask);
+
+        // Must match the order of the Value enum
+        const auto& s = preset.settings;
+        records.writeFloat(s.lowCutFreq);
+        records.writeFloat((float)s.lowCutSlope);
+        records.writeFloat(s.lowCutBypassed ? 1.f : 0.f);
+        records.writeFloat(s.peakFreq);
+        records.writeFloat(s.peakGainInDecibels);
+        records.writeFloat(s.peakQuality);
+        records.writeFloat(s.peakBypassed ? 1.f : 0.f);
+        records.writeFloat(s.highCutFreq);
+        records.writeFloat((float)s.highCutSlope);
+        records.writeFloat(s.highCutBypassed ? 1.f : 0.f);
+    }
+
+    const auto recordSizeToWrite = (size_t)recordHeaderSize + (size_t)NumValues * sizeof(float);
+    const auto recordsOffsetToWrite = (size_t)headerSize + tagTable.getDataSize();
+    const auto stringsOffsetToWrite = recordsOffsetToWrite + records.getDataSize();
+
+    jassert(records.getDataSize() == presets.size() * recordSizeToWrite);
+
+    juce::MemoryOutputStream out;
+    out.writeInt((int)magic);
+    out.writeInt((int)version);
+    out.writeInt((int)presets.size());
+    out.writeInt(tags.size());
+    out.writeInt((int)NumValues);
+    out.writeInt((int)recordSizeToWrite);
+    out.writeInt((int)recordsOffsetToWrite);
+    out.writeInt((int)stringsOffsetToWrite);
+    out.writeInt((int)strings.getDataSize());
+    out.writeInt(0); // reserved
+
+    jassert(out.getDataSize() == (size_t)headerSize);
+
+    out.write(tagTable.getData(), tagTable.getDataSize());
+    out.write(records.getData(), records.getDataSize());
+    out.write(strings.getData(), strings.getDataSize());
+
+    fileToWrite.getParentDirectory().createDirectory();
+    return fileToWrite.replaceWithData(out.getData(), out.getDataSize());
+}
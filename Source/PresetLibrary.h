@@ -0,0 +1,124 @@
+/*
+  ==============================================================================
+
+    PresetLibrary.h
+
+    A bank of presets kept in a single indexed file that is memory-mapped
+    instead of parsed.
+
+    Layout (all values little-endian):
+      header      magic, version, counts and offsets (see the offsets in the class)
+      tag table   numTags x { uint32 offset, uint32 length } into the string pool
+      records     numPresets x { uint32 nameOffset, uint32 nameLength,
+                                 uint32 tagMask, float values[numValues] }
+      strings     UTF-8 names and tag names, not null-terminated
+
+    Opening a bank only reads the header and the tag table, and listing or
+    filtering only touches the fixed-size records and the names they point at,
+    so it doesn't matter how many thousands of presets the bank holds.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+
+// Shared by every editor in the process. save() reorders the bank, so anyone
+// holding indices should listen for the change message and query again.
+class PresetLibrary : public juce::ChangeBroadcaster
+{
+public:
+    struct Preset
+    {
+        juce::String name;
+        juce::StringArray tags;
+        ChainSettings settings;
+    };
+
+    // Opens the user's bank, see getDefaultFile()
+    PresetLibrary();
+
+    static juce::File getDefaultFile();
+
+    bool open(const juce::File& fileToOpen);
+    void close();
+    bool isOpen() const { return mappedFile != nullptr; }
+
+    int getNumPresets() const { return numPresets; }
+    juce::String getName(int index) const;
+    juce::uint32 getTagMask(int index) const;
+    ChainSettings getSettings(int index) const;
+    Preset getPreset(int index) const;
+
+    // Tags are stored once per bank; a preset's tag mask has bit i set for tagNames[i]
+    const juce::StringArray& getTagNames() const { return tagNames; }
+
+    // Indices of the presets whose name contains nameFilter (ignoring case)
+    // and that carry every one of requiredTags. The names are matched on their
+    // bytes in the string pool, without building a juce::String for each.
+    juce::Array<int> find(const juce::String& nameFilter, const juce::StringArray& requiredTags) const;
+
+    // Rewrites the bank with 'preset' added, replacing any preset with the same name.
+    // Sends a synchronous change message, since every index handed out before is stale.
+    // Returns false without touching the bank if it would need more than maxNumTags
+    // different tags, see hasRoomForTags(), or if the file couldn't be written.
+    bool save(const Preset& preset);
+
+    // False if saving 'preset' would take the bank past maxNumTags different tags
+    bool hasRoomForTags(const Preset& preset) const;
+
+    // Returns false, writing nothing, if the presets use more than maxNumTags different tags
+    static bool write(const juce::File& fileToWrite, const std::vector<Preset>& presets);
+
+    static constexpr int maxNumTags = 32;
+
+private:
+    static constexpr juce::uint32 magic = 0x626c5153; // "SQlb"
+    static constexpr juce::uint32 version = 1;
+
+    static constexpr int headerSize = 40;
+    static constexpr int tagEntrySize = 8;
+    static constexpr int recordHeaderSize = 12;
+
+    // The ChainSettings fields, in the order they're stored in each record
+    enum Value
+    {
+        LowCutFreq,
+        LowCutSlope,
+        LowCutBypassed,
+        PeakFreq,
+        PeakGain,
+        PeakQuality,
+        PeakBypassed,
+        HighCutFreq,
+        HighCutSlope,
+        HighCutBypassed,
+        NumValues
+    };
+
+    std::unique_ptr<juce::MemoryMappedFile> mappedFile;
+    juce::File file;
+
+    const char* data = nullptr;
+    size_t dataSize = 0;
+
+    int numPresets = 0;
+    int numValuesPerRecord = 0;
+    size_t recordSize = 0, recordsOffset = 0, stringsOffset = 0, stringsSize = 0;
+
+    juce::StringArray tagNames;
+
+    // The bank as save() would write it
+    std::vector<Preset> getPresetsWith(const Preset& preset) const;
+
+    // Adds every different tag (ignoring case) to 'tags', false if there are more than maxNumTags
+    static bool collectTags(const std::vector<Preset>& presets, juce::StringArray& tags);
+
+    const char* getRecord(int index) const;
+    juce::String getString(juce::uint32 offset, juce::uint32 length) const;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PresetLibrary)
+};